@@ -21,9 +21,13 @@ Interface to C++ quantum circuit simulator with realistic noise.
 
 import json
 import logging
+import mmap
 import numbers
 import os
+import socket
+import struct
 import subprocess
+import tempfile
 from subprocess import PIPE
 
 import numpy as np
@@ -41,6 +45,13 @@ DEFAULT_SIMULATOR_PATHS = [
 ]
 logger = logging.getLogger(__name__)
 
+# Binary qobj format read by the simulator, see qobj_binary.hpp
+BINARY_QOBJ_MAGIC = b'QOBJBIN\x00'
+BINARY_QOBJ_VERSION = 1
+# name, flags, num_qubits, num_clbits, num_params, reserved, qubits, clbits,
+# params, cond_mask, cond_val
+BINARY_QOBJ_RECORD = struct.Struct('<6I5Q')
+
 
 class QISKitCppSimulator(BaseBackend):
     """C++ quantum circuit simulator with realistic noise"""
@@ -60,7 +71,10 @@ class QISKitCppSimulator(BaseBackend):
                 "basis_gates": 'u1,u2,u3,cx,id,x,y,z,h,s,sdg,t,tdg,wait,noise,save,load,uzz',
             }
 
-        # Try to use the default executable if not specified.
+        # Try to use the default executable if not specified. A simulator
+        # server given by a 'server' socket path is used instead if set.
+        if self._configuration.get('server'):
+            return
         if self._configuration.get('exe'):
             paths = [self._configuration.get('exe')]
         else:
@@ -77,7 +91,8 @@ class QISKitCppSimulator(BaseBackend):
 
     def run(self, q_job):
         qobj = q_job.qobj
-        result = run(qobj, self._configuration['exe'])
+        result = run(qobj, self._configuration.get('exe'),
+                     self._configuration.get('server'))
         return Result(result, qobj)
 
 
@@ -99,7 +114,10 @@ class CliffordCppSimulator(BaseBackend):
                 'basis_gates': 'cx,id,x,y,z,h,s,sdg,wait,noise,save,load'
             }
 
-        # Try to use the default executable if not specified.
+        # Try to use the default executable if not specified. A simulator
+        # server given by a 'server' socket path is used instead if set.
+        if self._configuration.get('server'):
+            return
         if self._configuration.get('exe'):
             paths = [self._configuration.get('exe')]
         else:
@@ -122,17 +140,26 @@ class CliffordCppSimulator(BaseBackend):
         else:
             qobj['config'] = {'simulator': 'clifford'}
 
-        result = run(qobj, self._configuration['exe'])
+        result = run(qobj, self._configuration.get('exe'),
+                     self._configuration.get('server'))
         return Result(result, qobj)
 
 
-def run(qobj, executable):
+def run(qobj, executable, server=None):
     """
-    Run simulation on C++ simulator inside a subprocess.
+    Run simulation on C++ simulator inside a subprocess, or on a simulator
+    server started with `qiskit_simulator --server <socket>`.
+
+    Circuits are parsed while earlier circuits are simulated, so if a circuit
+    cannot be parsed the circuits before it are still run and their results
+    returned, and the qobj fails with the parse error. The circuits from the
+    one that failed onwards get a failed result with the qobj status, so the
+    results are always in the order of the qobj circuits.
 
     Args:
         qobj (dict): qobj dictionary defining the simulation to run
         executable (string): filename (with path) of the simulator executable
+        server (string): socket path of a running simulator server
     Returns:
         dict: A dict of simulation results
     """
@@ -144,30 +171,200 @@ def run(qobj, executable):
             qobj['circuits'][j]['config'] = __to_json_complex(
                 qobj['circuits'][j]['config'])
 
-    # Open subprocess and execute external command
+    if server:
+        try:
+            cout = __run_server(json.dumps(qobj).encode(), server)
+        except OSError as err:
+            msg = "ERROR: Simulator server at %s failed: %s" % (server, err)
+            logger.error(msg)
+            return {"status": msg, "success": False}
+        return __parse_output(qobj, cout)
+
+    # Open subprocess and execute external command. Binary qobjs are passed
+    # as a file, which the simulator memory maps.
+    path = None
     try:
-        with subprocess.Popen([executable, '-'],
+        if qobj.get('config', {}).get('binary_qobj'):
+            with tempfile.NamedTemporaryFile(suffix='.qobj',
+                                             delete=False) as file:
+                path = file.name
+                write_binary_qobj(qobj, file)
+            args, cin = [executable, path], b''
+        else:
+            args, cin = [executable, '-'], json.dumps(qobj).encode()
+        with subprocess.Popen(args,
                               stdin=PIPE, stdout=PIPE, stderr=PIPE) as proc:
-            cin = json.dumps(qobj).encode()
             cout, cerr = proc.communicate(cin)
         if cerr:
             logger.error('ERROR: Simulator encountered a runtime error: %s',
                          cerr.decode())
-
-        cresult = json.loads(cout.decode())
-
-        if 'result' in cresult:
-            # If not Clifford simulator parse JSON complex numbers in output
-            if cresult.get('simulator') != 'clifford':
-                for result in cresult['result']:
-                    if result['success'] is True:
-                        __parse_sim_data(result['data'])
-        return cresult
+        return __parse_output(qobj, cout)
 
     except FileNotFoundError:
         msg = "ERROR: Simulator exe not found at: %s" % executable
         logger.error(msg)
         return {"status": msg, "success": False}
+    finally:
+        if path:
+            os.unlink(path)
+
+
+def write_binary_qobj(qobj, file):
+    """Write a qobj in the binary format read by the simulator.
+
+    The operations of each circuit are written as fixed width records, and
+    the "initial_state" and "target_states" of configs as raw complex128
+    arrays, so the simulator maps the file instead of parsing it.
+
+    Args:
+        qobj (dict): qobj dictionary defining the simulation to run
+        file (file): binary file object to write to
+    Raises:
+        ValueError: if an operation has symbolic parameters or a conditional
+            on more than 64 clbits
+    """
+    data = bytearray()
+    names = {}
+
+    def append(buf):
+        # Arrays are 8 byte aligned so the simulator can use them in place
+        offset = len(data)
+        data.extend(buf)
+        data.extend(bytes(-len(data) % 8))
+        return offset
+
+    def states(val, rank):
+        arr = np.asarray(val)
+        if not np.iscomplexobj(arr) and arr.ndim == rank + 1 \
+                and arr.shape[-1] == 2:
+            arr = arr[..., 0] + 1j * arr[..., 1]
+        arr = np.ascontiguousarray(arr, dtype='<c16')
+        if arr.ndim != rank:
+            raise ValueError("invalid state vector shape %s" % (arr.shape,))
+        return {'offset': append(arr.tobytes()), 'dtype': 'complex128',
+                'shape': list(arr.shape)}
+
+    def config(conf):
+        conf = dict(conf)
+        if 'initial_state' in conf:
+            conf['initial_state'] = states(conf['initial_state'], 1)
+        if 'target_states' in conf:
+            conf['target_states'] = states(conf['target_states'], 2)
+        return __to_json_complex(conf)
+
+    def record(op):
+        params = op.get('params', [])
+        if any(isinstance(par, str) for par in params):
+            raise ValueError("binary qobjs do not support symbolic "
+                             "parameters")
+        qubits = op.get('qubits', [])
+        clbits = op.get('clbits', [])
+        cond = op.get('conditional')
+        mask = int(cond['mask'], 16) if cond else 0
+        val = int(cond['val'], 16) if cond else 0
+        if max(mask, val) >= 1 << 64:
+            raise ValueError("binary qobjs do not support conditionals on "
+                             "more than 64 clbits")
+        return BINARY_QOBJ_RECORD.pack(
+            names.setdefault(op['name'], len(names)), 1 if cond else 0,
+            len(qubits), len(clbits), len(params), 0,
+            append(struct.pack('<%dQ' % len(qubits), *qubits)),
+            append(struct.pack('<%dQ' % len(clbits), *clbits)),
+            append(struct.pack('<%dd' % len(params), *params)), mask, val)
+
+    header = {key: val for key, val in qobj.items() if key != 'circuits'}
+    if 'config' in header:
+        header['config'] = config(header['config'])
+    header['circuits'] = []
+    for circ in qobj['circuits']:
+        circ = dict(circ)
+        if 'config' in circ:
+            circ['config'] = config(circ['config'])
+        compiled = dict(circ['compiled_circuit'])
+        ops = compiled['operations']
+        compiled['operations'] = {
+            'offset': append(b''.join(record(op) for op in ops)),
+            'count': len(ops)}
+        circ['compiled_circuit'] = compiled
+        header['circuits'].append(circ)
+    header['names'] = sorted(names, key=names.get)
+
+    text = json.dumps(header).encode()
+    file.write(BINARY_QOBJ_MAGIC)
+    file.write(struct.pack('<IIQ', BINARY_QOBJ_VERSION, 0, len(text)))
+    file.write(text + bytes(-len(text) % 8))
+    file.write(data)
+
+
+def __run_server(cin, server):
+    """Send a qobj to a simulator server and return its output.
+
+    Messages in both directions are an 8 byte little-endian length followed
+    by the JSON text.
+    """
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(server)
+        sock.sendall(struct.pack('<Q', len(cin)) + cin)
+        header = __recv_all(sock, 8)
+        return __recv_all(sock, struct.unpack('<Q', header)[0])
+
+
+def __recv_all(sock, size):
+    """Read exactly size bytes from a socket."""
+    chunks = []
+    while size > 0:
+        chunk = sock.recv(min(size, 1 << 20))
+        if not chunk:
+            raise OSError("connection closed by the simulator server")
+        chunks.append(chunk)
+        size -= len(chunk)
+    return b''.join(chunks)
+
+
+def __parse_output(qobj, cout):
+    """Parse the JSON output of the simulator."""
+    if qobj.get('config', {}).get('stream_output'):
+        cresult = __parse_stream(cout.decode())
+    else:
+        cresult = json.loads(cout.decode())
+
+    if 'result' in cresult:
+        # If not Clifford simulator parse JSON complex numbers in output
+        if cresult.get('simulator') != 'clifford':
+            for result in cresult['result']:
+                if result['success'] is True:
+                    __parse_sim_data(result['data'])
+
+    # Add a failed result for each circuit not run by a failed qobj
+    if cresult.get('success') is False:
+        results = cresult.setdefault('result', [])
+        for _ in range(len(results), len(qobj['circuits'])):
+            results.append({'status': cresult.get('status', 'ERROR'),
+                            'success': False})
+    return cresult
+
+
+def __parse_stream(output):
+    """Assemble the newline delimited JSON output of a streamed simulation.
+
+    The first line contains the qobj header values, each circuit result is
+    written as a line with its "index" in the qobj, and the last line contains
+    the qobj status. Lines of partial counts are ignored.
+    """
+    cresult = {}
+    results = []
+    for line in output.splitlines():
+        if not line.strip():
+            continue
+        record = json.loads(line)
+        if 'result' in record:
+            results.append((record['index'], record['result']))
+        elif 'partial' not in record:
+            cresult.update(record)
+    if results:
+        cresult['result'] = [res for _, res in sorted(results,
+                                                       key=lambda x: x[0])]
+    return cresult
 
 
 def __to_json_complex(obj):
@@ -212,12 +409,66 @@ def __parse_json_complex(val):
     return val
 
 
+def __is_binary(val):
+    return isinstance(val, dict) and 'file' in val and 'dtype' in val
+
+
+def __load_binary(val):
+    """Memory map an array written to a .npy file by the simulator."""
+    return np.load(val['file'], mmap_mode='r')
+
+
+def __is_shm(val):
+    return isinstance(val, dict) and 'shm' in val and 'dtype' in val
+
+
+def __load_shm(val):
+    """Map an array exported to POSIX shared memory by the simulator.
+
+    The segment is unlinked once mapped, so its memory is released when the
+    array is deleted. Segments are found in the /dev/shm file system of Linux.
+    """
+    path = os.path.join('/dev/shm', val['shm'].lstrip('/'))
+    with open(path, 'r+b') as file:
+        buf = mmap.mmap(file.fileno(), 0)
+    os.unlink(path)
+    return np.ndarray(val['shape'], dtype=val['dtype'], buffer=buf)
+
+
 def __parse_sim_data(data):
-    if 'quantum_states' in data:
+    # Parameter sweeps return the data of each parameter binding
+    if 'parameter_binds' in data:
+        for bind_data in data['parameter_binds']:
+            __parse_sim_data(bind_data)
+        return
+    # Arrays written to binary files with the "output_binary" config option
+    binary = set()
+    for key in ['quantum_states', 'density_matrix', 'probabilities']:
+        if key in data and __is_binary(data[key]):
+            data[key] = __load_binary(data[key])
+            binary.add(key)
+    for key in ['saved_quantum_states', 'saved_density_matrix',
+                'saved_probabilities']:
+        if key in data and isinstance(data[key], dict) and \
+                all(__is_binary(val) for val in data[key].values()):
+            data[key] = {int(i): __load_binary(val)
+                         for i, val in data[key].items()}
+            binary.add(key)
+    # State vectors exported with the "output_shm" config option
+    if 'quantum_states' in data and __is_shm(data['quantum_states']):
+        data['quantum_states'] = __load_shm(data['quantum_states'])
+        binary.add('quantum_states')
+    saved = data.get('saved_quantum_states')
+    if isinstance(saved, dict) and \
+            all(__is_shm(val) for val in saved.values()):
+        data['saved_quantum_states'] = {int(i): __load_shm(val)
+                                        for i, val in saved.items()}
+        binary.add('saved_quantum_states')
+    if 'quantum_states' in data and 'quantum_states' not in binary:
         tmp = [__parse_json_complex(psi)
                for psi in data['quantum_states']]
         data['quantum_states'] = tmp
-    if 'density_matrix' in data:
+    if 'density_matrix' in data and 'density_matrix' not in binary:
         tmp = np.array([__parse_json_complex(row)
                         for row in data['density_matrix']])
         data['density_matrix'] = tmp
@@ -225,14 +476,16 @@ def __parse_sim_data(data):
         tmp = [__parse_json_complex(ips)
                for ips in data['inner_products']]
         data['inner_products'] = tmp
-    if 'saved_quantum_states' in data:
+    if 'saved_quantum_states' in data and \
+            'saved_quantum_states' not in binary:
         for j in range(len(data['saved_quantum_states'])):
             tmp = {}
             for key, val in data['saved_quantum_states'][j].items():
                 val = __parse_json_complex(val)
                 tmp[int(key)] = val
             data['saved_quantum_states'][j] = tmp
-    if 'saved_density_matrix' in data:
+    if 'saved_density_matrix' in data and \
+            'saved_density_matrix' not in binary:
         for j in range(len(data['saved_density_matrix'])):
             tmp = {}
             for key, val in data['saved_density_matrix'][j].items():
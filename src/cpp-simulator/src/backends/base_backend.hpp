@@ -70,6 +70,50 @@ public:
    */
   void execute(const Circuit &prog);
 
+  /**
+   * Execute a range of operations of a program on the backend without
+   * reinitializing the backend state.
+   * @param prog the program containing the operations
+   * @param first position of the first operation to apply
+   * @param last position one past the last operation to apply
+   */
+  void execute_range(const Circuit &prog, uint_t first, uint_t last);
+
+  /**
+   * Returns the number of leading operations of a program whose action on the
+   * backend is the same for every shot. This prefix ends at the first
+   * measurement, reset, or conditional operation, or at the first operation
+   * applied while noise is switched on.
+   * @param prog the program to inspect
+   * @return the length of the deterministic prefix of the program
+   */
+  virtual uint_t deterministic_prefix(const Circuit &prog) const;
+
+  /**
+   * Snapshot of the backend state that is modified by executing operations.
+   */
+  struct Snapshot {
+    StateType qreg;
+    creg_t creg;
+    std::map<uint_t, StateType> qreg_saved;
+    bool noise_flag;
+  };
+
+  /**
+   * Returns a copy of the current backend state.
+   * @return the snapshot of the state
+   */
+  inline Snapshot snapshot() const {
+    return Snapshot{qreg, creg, qreg_saved, noise_flag};
+  };
+
+  /**
+   * Restores the backend state from a snapshot. The backend must have been
+   * initialized for the same program the snapshot was taken from.
+   * @param snap the snapshot to restore
+   */
+  void restore(const Snapshot &snap);
+
   /**
    * Tests whether the the condition for implementing a conditional gate passes
    * @param
@@ -162,6 +206,8 @@ public:
     if (n > 0)
       omp_threshold = n;
   };
+  // Number of threads to use for parallel loops over the current state
+  inline uint_t get_omp_threads() const { return omp_flag ? omp_threads : 1; };
 
   /**
    * Noise Settings
@@ -171,6 +217,9 @@ public:
   void attach_noise(const QubitNoise &np);
   int_t reset_error(const uint_t state = 0);
   int_t measure_error(uint_t n);
+  inline bool readout_error() const {
+    return noise_flag && noise.readout.ideal == false;
+  };
   int_t relax_error();
   const GateError &gate_error(std::string gateName);
 
@@ -253,9 +302,44 @@ void BaseBackend<StateType>::execute(const Circuit &prog) {
   initialize(prog);
 
   // Run through operation list
-  for (const auto &op : prog.operations)
+  execute_range(prog, 0, prog.operations.size());
+}
+
+template <class StateType>
+void BaseBackend<StateType>::execute_range(const Circuit &prog, uint_t first,
+                                           uint_t last) {
+  for (uint_t pos = first; pos < last; pos++) {
+    const auto &op = prog.operations[pos];
     if (!op.if_op || (op.if_op && qc_passed_if(op.cond)))
       qc_operation(op);
+  }
+}
+
+template <class StateType>
+uint_t BaseBackend<StateType>::deterministic_prefix(const Circuit &prog) const {
+  bool noisy = !ideal_sim; // noise is on at the start of each shot
+  uint_t pos = 0;
+  for (const auto &op : prog.operations) {
+    if (op.if_op || op.id == gate_t::Measure || op.id == gate_t::Reset)
+      break;
+    if (op.id == gate_t::Noise) {
+      noisy = !ideal_sim && (op.params[0] > 0.);
+      if (noisy)
+        break;
+    } else if (noisy && op.id != gate_t::Barrier && op.id != gate_t::Save &&
+               op.id != gate_t::Load)
+      break;
+    pos++;
+  }
+  return pos;
+}
+
+template <class StateType>
+void BaseBackend<StateType>::restore(const Snapshot &snap) {
+  qreg = snap.qreg;
+  creg = snap.creg;
+  qreg_saved = snap.qreg_saved;
+  noise_flag = snap.noise_flag;
 }
 
 template <class StateType>
@@ -60,6 +60,32 @@ public:
 
   const static gateset_t gateset;
 
+  /************************
+   * Adjoint differentiation
+   ************************/
+
+  /**
+   * Returns the number of continuous parameters of a gate operation that it
+   * can be differentiated with respect to.
+   */
+  static uint_t num_gate_params(const operation &op);
+
+  /**
+   * Apply the inverse of a unitary gate operation. An error is raised for
+   * non-unitary operations and simulator commands.
+   */
+  void qc_inverse(const operation &op);
+
+  /**
+   * Apply the derivative of a gate operation with respect to one of its
+   * parameters. The derivative is only defined up to terms proportional to
+   * the gate itself which do not contribute to the gradient of an expectation
+   * value.
+   * @param op the gate operation
+   * @param param the index of the parameter in op.params
+   */
+  void qc_derivative(const operation &op, uint_t param);
+
   /************************
    * Measurement probabilities
    ************************/
@@ -97,6 +123,10 @@ protected:
    ************************/
   virtual cmatrix_t waltz_matrix(const double theta, const double phi,
                                  const double lambda);
+  // derivative of the waltz matrix with respect to theta (0), phi (1) or
+  // lambda (2)
+  cmatrix_t waltz_derivative(const double theta, const double phi,
+                             const double lambda, const uint_t param);
   virtual void qc_gate(const uint_t qubit, const double theta, const double phi,
                        const double lambda);
   virtual void qc_gate_x(const uint_t qubit);
@@ -567,6 +597,133 @@ cmatrix_t IdealBackend::waltz_matrix(double theta, double phi, double lambda) {
   return U;
 }
 
+cmatrix_t IdealBackend::waltz_derivative(double theta, double phi,
+                                         double lambda, uint_t param) {
+  const complex_t I(0., 1.);
+  const double c = std::cos(theta / 2.), s = std::sin(theta / 2.);
+  cmatrix_t D(2, 2);
+  switch (param) {
+  case 0: // theta
+    D(0, 0) = -0.5 * s;
+    D(0, 1) = -0.5 * std::exp(I * lambda) * c;
+    D(1, 0) = 0.5 * std::exp(I * phi) * c;
+    D(1, 1) = -0.5 * std::exp(I * (phi + lambda)) * s;
+    break;
+  case 1: // phi
+    D(1, 0) = I * std::exp(I * phi) * s;
+    D(1, 1) = I * std::exp(I * (phi + lambda)) * c;
+    break;
+  case 2: // lambda
+    D(0, 1) = -I * std::exp(I * lambda) * s;
+    D(1, 1) = I * std::exp(I * (phi + lambda)) * c;
+    break;
+  default:
+    throw std::runtime_error("invalid waltz gate parameter");
+  }
+  return D;
+}
+
+//------------------------------------------------------------------------------
+// Adjoint differentiation
+//------------------------------------------------------------------------------
+
+uint_t IdealBackend::num_gate_params(const operation &op) {
+  if (op.if_op)
+    return 0;
+  switch (op.id) {
+  case gate_t::U:
+  case gate_t::U3:
+    return 3;
+  case gate_t::U2:
+    return 2;
+  case gate_t::U1:
+  case gate_t::UZZ:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+void IdealBackend::qc_inverse(const operation &op) {
+  if (op.if_op)
+    throw std::runtime_error("conditional operation \"" + op.name +
+                             "\" has no inverse");
+  operation inv = op;
+  switch (op.id) {
+  // self-inverse and identity gates
+  case gate_t::CX:
+  case gate_t::CZ:
+  case gate_t::X:
+  case gate_t::Y:
+  case gate_t::Z:
+  case gate_t::H:
+  case gate_t::I:
+  case gate_t::U0:
+  case gate_t::Barrier:
+  case gate_t::Wait:
+    break;
+  // U(theta, phi, lambda)^dagger = U(-theta, -lambda, -phi)
+  case gate_t::U:
+  case gate_t::U3:
+    inv.id = gate_t::U;
+    inv.params = {-op.params[0], -op.params[2], -op.params[1]};
+    break;
+  case gate_t::U2:
+    inv.id = gate_t::U;
+    inv.params = {-M_PI / 2., -op.params[1], -op.params[0]};
+    break;
+  case gate_t::U1:
+  case gate_t::UZZ:
+    inv.params = {-op.params[0]};
+    break;
+  case gate_t::S:
+    inv.id = gate_t::Sd;
+    break;
+  case gate_t::Sd:
+    inv.id = gate_t::S;
+    break;
+  case gate_t::T:
+    inv.id = gate_t::Td;
+    break;
+  case gate_t::Td:
+    inv.id = gate_t::T;
+    break;
+  default:
+    throw std::runtime_error("operation \"" + op.name + "\" has no inverse");
+  }
+  qc_operation(inv);
+}
+
+void IdealBackend::qc_derivative(const operation &op, uint_t param) {
+  if (param >= num_gate_params(op))
+    throw std::runtime_error("invalid parameter for derivative of \"" +
+                             op.name + "\"");
+  const complex_t I(0., 1.);
+  switch (op.id) {
+  case gate_t::U:
+  case gate_t::U3:
+    qc_matrix1(op.qubits[0], waltz_derivative(op.params[0], op.params[1],
+                                              op.params[2], param));
+    break;
+  case gate_t::U2:
+    qc_matrix1(op.qubits[0], waltz_derivative(M_PI / 2., op.params[0],
+                                              op.params[1], param + 1));
+    break;
+  case gate_t::U1: {
+    cmatrix_t D(2, 2);
+    D(1, 1) = I * std::exp(I * op.params[0]);
+    qc_matrix1(op.qubits[0], D);
+  } break;
+  case gate_t::UZZ: {
+    cmatrix_t D(4, 4);
+    D(1, 1) = D(2, 2) = 0.5 * I * std::exp(I * op.params[0] / 2.);
+    qc_matrix2(op.qubits[0], op.qubits[1], D);
+  } break;
+  default:
+    break;
+  }
+}
+
 //------------------------------------------------------------------------------
 // Measurement
 //------------------------------------------------------------------------------
@@ -292,6 +292,12 @@ public:
    * @returns: true if noise parameters are valid
    ***/
   bool verify(uint_t dim = 2);
+
+  /***
+   * Returns true if the noise model does not change the evolution of the
+   * quantum state, ie. if the only errors set are readout errors.
+   ***/
+  bool readout_only() const;
 };
 
 /*******************************************************************************
@@ -616,6 +622,13 @@ bool QubitNoise::verify(uint_t dim) {
   return pass;
 }
 
+bool QubitNoise::readout_only() const {
+  bool pass = reset.ideal && !(relax.rate > 0.);
+  for (const auto &g : gate)
+    pass = pass && g.second.ideal;
+  return pass;
+}
+
 const std::vector<std::string>
     QubitNoise::gate_names({"X90", "CX", "CZ", "id", "U", "measure", "reset"});
 
@@ -90,6 +90,14 @@ public:
    */
   int_t rand_int(std::vector<double> probs);
 
+  /**
+   * Generate a pseudo random integer from a binomial distribution
+   * @param n the number of trials
+   * @param p the success probability of each trial
+   * @return the number of successes
+   */
+  uint_t rand_binomial(uint_t n, double p);
+
   /**
    * Default constructor initialize RNG engine with a random seed
    */
@@ -157,5 +165,16 @@ int_t RngEngine::rand_int(std::vector<double> probs) {
   return n;
 }
 
+// binomially distributed integers in [0,n]
+uint_t RngEngine::rand_binomial(uint_t n, double p) {
+  uint_t k = std::binomial_distribution<uint_t>(n, p)(rng);
+#ifdef DEBUG
+  std::stringstream ss;
+  ss << "DEBUG: rand_binomial(" << n << "," << p << ") = " << k;
+  std::clog << ss.str() << std::endl;
+#endif
+  return k;
+}
+
 //------------------------------------------------------------------------------
 #endif
@@ -0,0 +1,316 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file capi.cpp
+ * @brief C API of the QISKIT Simulator shared library
+ *
+ * Circuits are constructed from the operation arrays by the same checks as
+ * qobj circuits and run directly on the engine and backend the executable
+ * would choose, so the library accepts exactly the gates and config options
+ * of the executable. Counts and states are copied from the engine into the
+ * result, and the JSON result is only built if it is requested.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "qiskit_simulator.h"
+#include "simulator.hpp"
+
+using namespace QISKIT;
+
+/*******************************************************************************
+ *
+ * Handles
+ *
+ ******************************************************************************/
+
+struct qiskit_circuit {
+  Circuit header; // the registers of the circuit, without operations
+  std::vector<std::pair<std::string, operation>> operations;
+  std::vector<json_t> conditionals; // json qobj conditional or null
+};
+
+struct qiskit_result {
+  bool success = false;
+  std::string status;
+  std::vector<std::pair<uint64_t, uint64_t>> counts;
+  cvector_t state;
+  std::function<json_t()> result; // builds the JSON circuit result
+  std::string text;               // JSON text, set on request
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+// Copies the final state of the first shot, as only state vectors are
+// returned and not Clifford tableaus
+void copy_state(const BaseEngine<cvector_t> &engine, qiskit_result &res) {
+  if (engine.output_qreg.empty() == false)
+    res.state = engine.output_qreg.front();
+}
+void copy_state(const BaseEngine<Clifford> &engine, qiskit_result &res) {
+  (void)engine;
+  (void)res;
+}
+
+// Runs a circuit on an engine and backend and copies its results
+template <class Engine, class Backend>
+void run_circuit(const Simulator &sim, Circuit &circ, qiskit_result &res) {
+  const auto start = std::chrono::steady_clock::now();
+  auto engine = std::make_shared<Engine>(circ.config.get<Engine>());
+  Backend backend = circ.config;
+  sim.setup_engine(circ, *engine, 0);
+  const uint_t seed = (circ.rng_seed < 0)
+                          ? std::random_device()()
+                          : static_cast<uint_t>(circ.rng_seed);
+  const uint_t threads = sim.run_engine(circ, *engine, backend, seed);
+  const double time_taken =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  // Outcomes of more than 64 clbits are only counted in the JSON result
+  res.counts.assign(engine->packed_counts.begin(),
+                    engine->packed_counts.end());
+  std::sort(res.counts.begin(), res.counts.end());
+  copy_state(*engine, res);
+  res.success = true;
+  res.status = "DONE";
+
+  // The JSON result has the fields of a result of the executable
+  json_t noise;
+  if (sim.simulator != "ideal" && JSON::check_key("noise_params", circ.config))
+    noise = backend.noise;
+  const uint_t shots = circ.shots;
+  res.result = [=]() {
+    json_t ret;
+    ret["data"] = *engine;
+    ret["data"]["time_taken"] = time_taken;
+    if (noise.is_null() == false)
+      ret["noise_params"] = noise;
+    ret["name"] = std::string();
+    ret["shots"] = shots;
+    ret["seed"] = seed;
+    if (threads > 1)
+      ret["threads_shot"] = threads;
+    ret["success"] = true;
+    ret["status"] = std::string("DONE");
+    return ret;
+  };
+}
+
+// Returns the json qobj conditional of a C API operation
+json_t conditional(const qiskit_operation &op) {
+  json_t cond;
+  if (op.cond_mask != 0) {
+    std::stringstream mask, val;
+    mask << "0x" << std::hex << op.cond_mask;
+    val << "0x" << std::hex << op.cond_val;
+    cond["type"] = std::string("equals");
+    cond["mask"] = mask.str();
+    cond["val"] = val.str();
+  }
+  return cond;
+}
+
+} // namespace
+
+/*******************************************************************************
+ *
+ * C API
+ *
+ ******************************************************************************/
+
+int qiskit_api_version(void) { return QISKIT_SIMULATOR_API_VERSION; }
+
+void qiskit_config_init(qiskit_config *config) {
+  if (config == nullptr)
+    return;
+  config->simulator = "qubit";
+  config->shots = 1;
+  config->seed = -1;
+  config->max_threads = 0;
+  config->quantum_state = 0;
+  config->options = nullptr;
+}
+
+qiskit_circuit *qiskit_circuit_create(uint64_t num_qubits,
+                                      uint64_t num_clbits,
+                                      const qiskit_operation *ops,
+                                      uint64_t num_ops) {
+  try {
+    if (ops == nullptr && num_ops > 0)
+      throw std::invalid_argument("operations are NULL");
+    json_t header;
+    header["number_of_qubits"] = num_qubits;
+    header["number_of_clbits"] = num_clbits;
+    header["qubit_labels"] = json_t::array();
+    for (uint64_t q = 0; q < num_qubits; q++)
+      header["qubit_labels"].push_back({"q", q});
+    header["clbit_labels"] = json_t::array();
+    if (num_clbits > 0)
+      header["clbit_labels"].push_back({"c", num_clbits});
+
+    auto circ = std::unique_ptr<qiskit_circuit>(new qiskit_circuit);
+    circ->header.parse_header(header);
+    for (uint64_t j = 0; j < num_ops; j++) {
+      const qiskit_operation &op = ops[j];
+      if (op.name == nullptr)
+        throw std::invalid_argument("operation " + std::to_string(j) +
+                                    " has no name");
+      operation cop;
+      if (op.num_qubits > 0)
+        cop.qubits.assign(op.qubits, op.qubits + op.num_qubits);
+      if (op.num_clbits > 0)
+        cop.clbits.assign(op.clbits, op.clbits + op.num_clbits);
+      if (op.num_params > 0)
+        cop.params.assign(op.params, op.params + op.num_params);
+      circ->operations.emplace_back(op.name, std::move(cop));
+      circ->conditionals.push_back(conditional(op));
+    }
+    return circ.release();
+  } catch (std::exception &e) {
+    last_error = e.what();
+    return nullptr;
+  }
+}
+
+void qiskit_circuit_free(qiskit_circuit *circuit) { delete circuit; }
+
+qiskit_result *qiskit_run(const qiskit_circuit *circuit,
+                          const qiskit_config *config) {
+  if (circuit == nullptr || config == nullptr) {
+    last_error = "circuit or config is NULL";
+    return nullptr;
+  }
+  auto res = new qiskit_result;
+  try {
+    // Load the simulator options from a qobj without circuits
+    json_t conf = json_t::object();
+    if (config->options != nullptr)
+      conf = json_t::parse(config->options);
+    if (config->simulator != nullptr)
+      conf["simulator"] = config->simulator;
+    conf["shots"] = config->shots;
+    if (config->seed >= 0)
+      conf["seed"] = config->seed;
+    if (config->max_threads > 0)
+      conf["max_threads"] = config->max_threads;
+    if (config->quantum_state)
+      conf["data"].push_back("quantumstate");
+    json_t qobj;
+    qobj["id"] = "capi";
+    qobj["config"] = std::move(conf);
+    qobj["circuits"] = json_t::array();
+    Simulator sim = qobj;
+
+    // Operations are checked against the gateset of the simulator
+    Circuit circ = circuit->header;
+    for (uint_t j = 0; j < circuit->operations.size(); j++) {
+      operation op = circuit->operations[j].second;
+      circ.add_operation(std::move(op), circuit->operations[j].first,
+                         sim.gateset, circuit->conditionals[j]);
+    }
+    circ.set_config(json_t(), sim.config, sim.gateset);
+    sim.check_memory(circ);
+
+    // Run on the engine and backend the executable would choose
+    sim.dispatch(circ, [&](auto type) {
+      using Type = decltype(type);
+      run_circuit<typename Type::engine_t, typename Type::backend_t>(
+          sim, circ, *res);
+    });
+  } catch (std::exception &e) {
+    res->success = false;
+    res->status = std::string("ERROR: ") + e.what();
+    res->counts.clear();
+    res->state.clear();
+    const std::string status = res->status;
+    res->result = [status]() {
+      json_t ret;
+      ret["success"] = false;
+      ret["status"] = status;
+      return ret;
+    };
+  }
+  if (res->success == false)
+    last_error = res->status;
+  return res;
+}
+
+void qiskit_result_free(qiskit_result *result) { delete result; }
+
+int qiskit_result_success(const qiskit_result *result) {
+  return result != nullptr && result->success;
+}
+
+const char *qiskit_result_status(const qiskit_result *result) {
+  return (result == nullptr) ? "" : result->status.c_str();
+}
+
+uint64_t qiskit_result_num_outcomes(const qiskit_result *result) {
+  return (result == nullptr) ? 0 : result->counts.size();
+}
+
+uint64_t qiskit_result_counts(const qiskit_result *result, uint64_t *outcomes,
+                              uint64_t *counts, uint64_t size) {
+  if (result == nullptr)
+    return 0;
+  const uint64_t n = std::min<uint64_t>(size, result->counts.size());
+  for (uint64_t j = 0; j < n; j++) {
+    if (outcomes != nullptr)
+      outcomes[j] = result->counts[j].first;
+    if (counts != nullptr)
+      counts[j] = result->counts[j].second;
+  }
+  return n;
+}
+
+uint64_t qiskit_result_state_size(const qiskit_result *result) {
+  return (result == nullptr) ? 0 : result->state.size();
+}
+
+uint64_t qiskit_result_state(const qiskit_result *result, double *amplitudes,
+                             uint64_t size) {
+  if (result == nullptr || amplitudes == nullptr)
+    return 0;
+  const uint64_t n = std::min<uint64_t>(size, result->state.size());
+  for (uint64_t j = 0; j < n; j++) {
+    amplitudes[2 * j] = std::real(result->state[j]);
+    amplitudes[2 * j + 1] = std::imag(result->state[j]);
+  }
+  return n;
+}
+
+const char *qiskit_result_json(qiskit_result *result) {
+  if (result == nullptr)
+    return "";
+  if (result->text.empty())
+    result->text = result->result().dump();
+  return result->text.c_str();
+}
+
+const char *qiskit_last_error(void) { return last_error.c_str(); }
@@ -23,8 +23,15 @@ limitations under the License.
 #ifndef _BaseEngine_h_
 #define _BaseEngine_h_
 
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+
 #include "base_backend.hpp"
 #include "circuit.hpp"
+#include "lru_cache.hpp"
 #include "noise_models.hpp"
 
 namespace QISKIT {
@@ -68,6 +75,27 @@ public:
 
   bool initial_state_flag = false;
 
+  // Path prefix for writing state data to binary .npy files instead of JSON
+  std::string output_binary = "";
+
+  // Name prefix for exporting state vectors to POSIX shared memory segments
+  // instead of JSON
+  std::string output_shm = "";
+
+  // Simulate the deterministic prefix of a circuit once and branch each shot
+  // from a snapshot of the resulting state
+  bool shot_branching = true;
+
+  // Cache of deterministic prefix states shared with other engines. If set,
+  // the prefix state of a circuit is stored at its end and at each of the
+  // checkpoint operation indices, and a later circuit with the same leading
+  // operations resumes from the latest cached checkpoint.
+  using checkpoint_cache_t =
+      LRUCache<typename BaseBackend<StateType>::Snapshot>;
+  std::shared_ptr<checkpoint_cache_t> checkpoint_cache;
+  std::vector<uint_t> checkpoints;
+  bool checkpoint_prefix = true; // store the state at the end of the prefix
+
   //============================================================================
   // Results / Data
   //============================================================================
@@ -77,6 +105,12 @@ public:
   double time_taken = 0.; // Time taken for simulation of current results
   counts_t counts;        // Map of observed final creg values
 
+  // Final creg values of at most 64 bits are counted as packed integers, with
+  // bit j of the key the value of creg[j], and only converted to bitstrings
+  // in the counts map when the results are serialized
+  std::unordered_map<uint_t, uint_t> packed_counts;
+  reglist clbit_labels; // classical registers of the packed counts
+
   // Final States
   std::vector<std::string> output_creg; // creg string for each shot
   std::vector<StateType> output_qreg;   // final qreg state for each shot
@@ -115,12 +149,44 @@ public:
   virtual void execute(Circuit &circ, BaseBackend<StateType> *be,
                        uint_t nshots);
 
+  /**
+   * Initializes the backend for a program and executes its operations up to
+   * pos, which must not exceed the deterministic prefix of the program. If a
+   * checkpoint cache is set the execution resumes from the latest cached
+   * checkpoint and stores the checkpoints it passes.
+   * @param circ the circuit to be executed
+   * @param be the backend to execute the circuit on
+   * @param pos the number of operations to execute
+   */
+  void execute_prefix(const Circuit &circ, BaseBackend<StateType> *be,
+                      uint_t pos);
+
+  /**
+   * Returns true if the engine evaluates all shots of a circuit from a single
+   * simulation by sampling the final measurement outcomes.
+   * @param circ the circuit to be executed
+   * @param be the backend to execute the circuit on
+   */
+  virtual bool sample_measurements(const Circuit &circ,
+                                   const BaseBackend<StateType> *be) const {
+    (void)circ;
+    (void)be;
+    return false;
+  };
+
   /**
    * Adds results data from another engine.
    * @param eng the engine to combine.
    */
   void add(const BaseEngine<StateType> &eng);
 
+  /**
+   * Adds results data from another engine by moving its containers instead
+   * of copying them. The results of eng are left in an unspecified state.
+   * @param eng the engine to combine.
+   */
+  void add(BaseEngine<StateType> &&eng);
+
   /**
    * Overloads the += operator to combine the results of different engines.
    */
@@ -128,6 +194,10 @@ public:
     add(eng);
     return *this;
   };
+  inline BaseEngine &operator+=(BaseEngine<StateType> &&eng) {
+    add(std::move(eng));
+    return *this;
+  };
 
   /**
    * This function calculates results to based on the state of the backend after
@@ -138,7 +208,34 @@ public:
    */
   virtual void compute_results(Circuit &circ, BaseBackend<StateType> *be);
 
-  void compute_counts(const reglist clbit_labels, const creg_t &creg);
+  /**
+   * Records the bitstring of a classical register value in the counts and
+   * the list of observed outcomes.
+   * @param creg_labels the classical registers of the circuit
+   * @param creg the classical register value
+   * @param nshots the number of shots that observed this value
+   */
+  void compute_counts(const reglist &creg_labels, const creg_t &creg,
+                      uint_t nshots = 1);
+
+  /**
+   * Returns the counts bitstring of a classical register value.
+   * @param creg_labels the classical registers of the circuit
+   * @param creg the classical register value
+   */
+  std::string creg_string(const reglist &creg_labels,
+                          const creg_t &creg) const;
+
+  /**
+   * Returns the map of all observed final creg bitstrings including the
+   * packed counts.
+   */
+  counts_t merged_counts() const;
+
+  /**
+   * Clears all recorded counts and classical states
+   */
+  void clear_counts();
 };
 
 /*******************************************************************************
@@ -151,6 +248,7 @@ template <typename StateType>
 void BaseEngine<StateType>::run_program(Circuit &prog,
                                         BaseBackend<StateType> *be,
                                         uint_t nshots, uint_t nthreads) {
+  clbit_labels = prog.clbit_labels;
   initialize(be, nthreads);
   execute(prog, be, nshots);
   total_shots += nshots;
@@ -170,12 +268,86 @@ void BaseEngine<StateType>::initialize(BaseBackend<StateType> *be,
 template <typename StateType>
 void BaseEngine<StateType>::execute(Circuit &prog, BaseBackend<StateType> *be,
                                     uint_t nshots) {
+  const bool branch = shot_branching && nshots > 1;
+  const uint_t pos =
+      (branch || checkpoint_cache) ? be->deterministic_prefix(prog) : 0;
+  if (pos == 0) {
+    for (uint_t ishot = 0; ishot < nshots; ++ishot) {
+      be->execute(prog);
+      compute_results(prog, be);
+    }
+    return;
+  }
+  const uint_t end = prog.operations.size();
+  if (branch == false) {
+    // Each shot resumes from the cached prefix state
+    for (uint_t ishot = 0; ishot < nshots; ++ishot) {
+      execute_prefix(prog, be, pos);
+      be->execute_range(prog, pos, end);
+      compute_results(prog, be);
+    }
+    return;
+  }
+  // Execute the shared prefix once and branch each shot from its end state
+  execute_prefix(prog, be, pos);
+  const auto prefix = be->snapshot();
   for (uint_t ishot = 0; ishot < nshots; ++ishot) {
-    be->execute(prog);
+    if (ishot > 0)
+      be->restore(prefix);
+    be->execute_range(prog, pos, end);
     compute_results(prog, be);
   }
 }
 
+template <typename StateType>
+void BaseEngine<StateType>::execute_prefix(const Circuit &prog,
+                                           BaseBackend<StateType> *be,
+                                           uint_t pos) {
+  be->initialize(prog);
+  if (!checkpoint_cache || pos == 0) {
+    be->execute_range(prog, 0, pos);
+    return;
+  }
+
+  // Checkpoint positions and the hashes of the operations preceding them.
+  // States of different backends may differ by rounding so the backend type
+  // is part of the key.
+  std::vector<uint_t> points;
+  for (const auto &p : checkpoints)
+    if (p > 0 && p <= pos)
+      points.push_back(p);
+  if (checkpoint_prefix)
+    points.push_back(pos);
+  std::sort(points.begin(), points.end());
+  points.erase(std::unique(points.begin(), points.end()), points.end());
+  std::vector<uint_t> keys;
+  const uint_t type = typeid(*be).hash_code();
+  uint_t hash = 0, last = 0;
+  for (const auto &p : points) {
+    hash = prog.hash_operations(last, p, hash);
+    keys.push_back(fnv1a_hash(&type, sizeof(type), hash));
+    last = p;
+  }
+
+  // Resume from the latest cached checkpoint
+  uint_t next = 0, start = 0;
+  for (uint_t k = points.size(); k-- > 0;) {
+    const auto snap = checkpoint_cache->find(keys[k]);
+    if (snap) {
+      be->restore(*snap);
+      start = points[k];
+      next = k + 1;
+      break;
+    }
+  }
+  for (uint_t k = next; k < points.size(); k++) {
+    be->execute_range(prog, start, points[k]);
+    checkpoint_cache->insert(keys[k], be->snapshot());
+    start = points[k];
+  }
+  be->execute_range(prog, start, pos);
+}
+
 template <typename StateType>
 void BaseEngine<StateType>::compute_results(Circuit &qasm,
                                             BaseBackend<StateType> *be) {
@@ -192,61 +364,112 @@ void BaseEngine<StateType>::compute_results(Circuit &qasm,
 }
 
 template <typename StateType>
-void BaseEngine<StateType>::compute_counts(const reglist clbit_labels,
-                                           const creg_t &creg) {
-  if (counts_show || show_final_creg) {
-    std::string shotstr;
-    uint_t shift = 0;
-
-    for (const auto &reg : clbit_labels) {
-      uint_t sz = reg.second;
-      for (uint_t j = 0; j < sz; j++) {
-        shotstr += std::to_string(creg[shift + j]);
-      }
-      shift += sz;
-      if (counts_space)
-        shotstr += " "; // opt whitespace between named cregs
+void BaseEngine<StateType>::compute_counts(const reglist &creg_labels,
+                                           const creg_t &creg, uint_t nshots) {
+  if (creg.empty())
+    return;
+
+  // add shot to shot map
+  if (counts_show) {
+    bool packed = (creg.size() <= 64);
+    uint_t key = 0;
+    for (uint_t j = 0; packed && j < creg.size(); j++) {
+      packed = (creg[j] < 2);
+      key |= creg[j] << j;
     }
-    if (shotstr.empty() == false && counts_space)
-      shotstr.pop_back(); // remove last whitspace char
+    if (packed)
+      packed_counts[key] += nshots;
+    else
+      counts[creg_string(creg_labels, creg)] += nshots;
+  }
 
-    // reverse shot string to least significant bit to the right
-    if (counts_bits_h2l == true)
-      std::reverse(shotstr.begin(), shotstr.end());
+  // add shot to shot history
+  if (show_final_creg)
+    output_creg.insert(output_creg.end(), nshots,
+                       creg_string(creg_labels, creg));
+}
 
-    // add shot to shot map
-    if (counts_show && shotstr.empty() == false)
-      counts[shotstr] += 1;
+template <typename StateType>
+std::string BaseEngine<StateType>::creg_string(const reglist &creg_labels,
+                                               const creg_t &creg) const {
+  std::string shotstr;
+  uint_t shift = 0;
+
+  for (const auto &reg : creg_labels) {
+    uint_t sz = reg.second;
+    for (uint_t j = 0; j < sz; j++) {
+      shotstr += std::to_string(creg[shift + j]);
+    }
+    shift += sz;
+    if (counts_space)
+      shotstr += " "; // opt whitespace between named cregs
+  }
+  if (shotstr.empty() == false && counts_space)
+    shotstr.pop_back(); // remove last whitspace char
+
+  // reverse shot string to least significant bit to the right
+  if (counts_bits_h2l == true)
+    std::reverse(shotstr.begin(), shotstr.end());
+  return shotstr;
+}
 
-    // add shot to shot history
-    if (show_final_creg && shotstr.empty() == false)
-      output_creg.push_back(shotstr);
+template <typename StateType>
+counts_t BaseEngine<StateType>::merged_counts() const {
+  counts_t ret = counts;
+  uint_t nbits = 0;
+  for (const auto &reg : clbit_labels)
+    nbits += reg.second;
+  creg_t creg(nbits);
+  for (const auto &pair : packed_counts) {
+    for (uint_t j = 0; j < nbits; j++)
+      creg[j] = (pair.first >> j) & 1ULL;
+    ret[creg_string(clbit_labels, creg)] += pair.second;
   }
+  return ret;
+}
+
+template <typename StateType> void BaseEngine<StateType>::clear_counts() {
+  counts.clear();
+  packed_counts.clear();
+  output_creg.clear();
 }
 
 template <typename StateType>
 void BaseEngine<StateType>::add(const BaseEngine<StateType> &eng) {
+  BaseEngine<StateType> tmp(eng);
+  add(std::move(tmp));
+}
+
+template <typename StateType>
+void BaseEngine<StateType>::add(BaseEngine<StateType> &&eng) {
   // add time taken
   time_taken += eng.time_taken;
 
   // add total shots;
   total_shots += eng.total_shots;
 
-  // copy counts
-  for (auto pair : eng.counts)
-    counts[pair.first] += pair.second;
-
-  // copy output cregs
-  std::copy(eng.output_creg.begin(), eng.output_creg.end(),
-            std::back_inserter(output_creg));
-
-  // copy output qregs
-  std::copy(eng.output_qreg.begin(), eng.output_qreg.end(),
-            back_inserter(output_qreg));
-
-  // copy saved qregs
-  std::copy(eng.saved_qreg.begin(), eng.saved_qreg.end(),
-            back_inserter(saved_qreg));
+  // add counts
+  if (counts.empty())
+    counts.swap(eng.counts);
+  else
+    for (const auto &pair : eng.counts)
+      counts[pair.first] += pair.second;
+  if (packed_counts.empty())
+    packed_counts.swap(eng.packed_counts);
+  else
+    for (const auto &pair : eng.packed_counts)
+      packed_counts[pair.first] += pair.second;
+  if (clbit_labels.empty())
+    clbit_labels = eng.clbit_labels;
+
+  // move output cregs
+  move_append(output_creg, eng.output_creg);
+
+  // move output qregs
+  move_append(output_qreg, eng.output_qreg);
+
+  // move saved qregs
+  move_append(saved_qreg, eng.saved_qreg);
 }
 
 /*******************************************************************************
@@ -258,13 +481,21 @@ void BaseEngine<StateType>::add(const BaseEngine<StateType> &eng) {
 template <typename StateType>
 inline void to_json(json_t &js, const BaseEngine<StateType> &engine) {
 
-  if (engine.counts_show && engine.counts.empty() == false)
-    js["counts"] = engine.counts;
+  if (engine.counts_show &&
+      (engine.counts.empty() == false || engine.packed_counts.empty() == false))
+    js["counts"] = engine.merged_counts();
 
   if (engine.show_final_creg && engine.output_creg.empty() == false)
     js["classical_states"] = engine.output_creg;
 
-  if (engine.show_final_qreg && engine.output_qreg.empty() == false)
+  // vector states are written to binary files or shared memory by the
+  // VectorEngine
+  const bool vector_state = std::is_same<StateType, cvector_t>::value;
+  const bool binary_qreg =
+      vector_state && (engine.output_binary.empty() == false ||
+                       engine.output_shm.empty() == false);
+  if (engine.show_final_qreg && engine.output_qreg.empty() == false &&
+      binary_qreg == false)
     try {
       // use try incase state class doesn't have json conversion method
       json_t js_qreg = engine.output_qreg;
@@ -274,7 +505,8 @@ inline void to_json(json_t &js, const BaseEngine<StateType> &engine) {
       js["quantum_states"] = "Error: Failed to convert state type to JSON";
     }
 
-  if (engine.show_saved_qreg && engine.saved_qreg.empty() == false)
+  if (engine.show_saved_qreg && engine.saved_qreg.empty() == false &&
+      binary_qreg == false)
     try {
       // use try incase state class doesn't have json conversion method
       json_t js_qreg = engine.saved_qreg;
@@ -319,6 +551,17 @@ inline void from_json(const json_t &js, BaseEngine<StateType> &engine) {
 
   // Get omp threshold
   JSON::get_value(engine.omp_threshold, "omp_threshold", js);
+
+  // Shot branching from the deterministic circuit prefix
+  JSON::get_value(engine.shot_branching, "shot_branching", js);
+
+  // Operation indices of checkpoints for the checkpoint cache
+  JSON::get_value(engine.checkpoints, "checkpoints", js);
+  JSON::get_value(engine.checkpoint_prefix, "checkpoint_prefix", js);
+
+  // Binary output of state data
+  JSON::get_value(engine.output_binary, "output_binary", js);
+  JSON::get_value(engine.output_shm, "output_shm", js);
 }
 
 //------------------------------------------------------------------------------
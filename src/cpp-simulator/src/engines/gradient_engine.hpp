@@ -0,0 +1,232 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    gradient_engine.hpp
+ * @brief   Gradient Engine class for the ideal state vector backend
+ */
+
+#ifndef _GradientEngine_h_
+#define _GradientEngine_h_
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "ideal_backend.hpp"
+#include "sampleshots_engine.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+ *
+ * GradientEngine class
+ *
+ * This class is derived from the SampleShotsEngine class. In addition to the
+ * SampleShotsEngine results it computes the gradient of the expectation value
+ * of each observable in the "observables" config option with respect to every
+ * gate parameter of the circuit, using the adjoint method:
+ *
+ * 1. The circuit is run forward once to the final state |psi>.
+ * 2. For each observable O the vector |lambda> = O|psi> is computed.
+ * 3. The gates are undone in reverse order by applying their inverse to both
+ *    |psi> and |lambda>. Before undoing a gate U(theta) the derivative of the
+ *    expectation value with respect to theta is 2 Re <lambda|dU/dtheta|psi>
+ *    where |psi> is the state before the gate.
+ *
+ * Any measurements must be at the end of the circuit, and the gradient is that
+ * of the state before the measurements. Only ideal circuits are supported.
+ *
+ ******************************************************************************/
+
+class GradientEngine : public SampleShotsEngine {
+
+public:
+  // Default constructor
+  GradientEngine() : SampleShotsEngine(){};
+
+  //============================================================================
+  // Configuration
+  //============================================================================
+  bool show_gradients = false; // compute gradients of observables
+
+  //============================================================================
+  // Results / Data
+  //============================================================================
+
+  // Gradient of each observable with respect to each gate parameter
+  std::vector<rvector_t> output_gradients;
+  // (operation index, parameter index) of each gradient entry
+  std::vector<std::pair<uint_t, uint_t>> gradient_params;
+
+  //============================================================================
+  // Methods
+  //============================================================================
+
+  // Runs the shots and computes the gradients once for the circuit
+  void run_program(Circuit &circ, BaseBackend<cvector_t> *be,
+                   uint_t nshots = 1, uint_t nthreads = 1);
+
+  // Computes the gradients of all observables by the adjoint method
+  void compute_gradients(const Circuit &circ, IdealBackend *be);
+
+  // Adds results data from another engine
+  void add(const GradientEngine &eng);
+  void add(GradientEngine &&eng);
+
+  // Overloads the += operator to combine the results of different engines
+  GradientEngine &operator+=(const GradientEngine &eng) {
+    add(eng);
+    return *this;
+  };
+  GradientEngine &operator+=(GradientEngine &&eng) {
+    add(std::move(eng));
+    return *this;
+  };
+};
+
+/***************************************************************************/ /**
+  *
+  * GradientEngine methods
+  *
+  ******************************************************************************/
+
+void GradientEngine::run_program(Circuit &prog, BaseBackend<cvector_t> *be,
+                                 uint_t nshots, uint_t nthreads) {
+  SampleShotsEngine::run_program(prog, be, nshots, nthreads);
+  // Gradients are deterministic so are only computed for the first batch
+  if (show_gradients && output_gradients.empty()) {
+    IdealBackend *ideal = dynamic_cast<IdealBackend *>(be);
+    if (ideal == nullptr)
+      throw std::runtime_error("gradients require the ideal backend");
+    compute_gradients(prog, ideal);
+  }
+}
+
+void GradientEngine::compute_gradients(const Circuit &prog, IdealBackend *be) {
+  if (observables.empty())
+    throw std::runtime_error("gradients require the \"observables\" option");
+
+  // Gates are applied up to the first measurement
+  const auto &ops = prog.operations;
+  uint_t pos = 0;
+  while (pos < ops.size() && ops[pos].id != gate_t::Measure)
+    pos++;
+  for (uint_t j = pos; j < ops.size(); j++)
+    if (ops[j].id != gate_t::Measure && ops[j].id != gate_t::Barrier)
+      throw std::runtime_error("gradients require all measurements to be at "
+                               "the end of the circuit");
+
+  // Forward pass
+  const uint_t det = std::min(pos, be->deterministic_prefix(prog));
+  execute_prefix(prog, be, det);
+  be->execute_range(prog, det, pos);
+  const uint_t nthreads = be->get_omp_threads();
+  cvector_t psi = be->access_qreg();
+  std::vector<cvector_t> lambdas;
+  for (const auto &obs : observables)
+    lambdas.push_back(obs.apply(psi, nthreads));
+
+  // Parameters of the circuit in order of operations
+  gradient_params.clear();
+  for (uint_t j = 0; j < pos; j++)
+    for (uint_t p = 0; p < IdealBackend::num_gate_params(ops[j]); p++)
+      gradient_params.push_back(std::make_pair(j, p));
+  const uint_t nparams = gradient_params.size();
+  output_gradients.assign(observables.size(), rvector_t(nparams, 0.));
+
+  // Backward pass. The backend state register is swapped with each vector to
+  // apply the backend gate kernels to it.
+  cvector_t &qreg = be->access_qreg();
+  cvector_t mu;
+  uint_t ipar = nparams;
+  for (uint_t j = pos; j-- > 0;) {
+    const operation &op = ops[j];
+    qreg.swap(psi);
+    be->qc_inverse(op);
+    qreg.swap(psi);
+    const uint_t np = IdealBackend::num_gate_params(op);
+    for (uint_t p = np; p-- > 0;) {
+      ipar--;
+      mu = psi;
+      qreg.swap(mu);
+      be->qc_derivative(op, p);
+      qreg.swap(mu);
+      for (uint_t k = 0; k < lambdas.size(); k++) {
+        double val = 2. * std::real(inner_product(lambdas[k], mu));
+        chop(val, epsilon);
+        output_gradients[k][ipar] = val;
+      }
+    }
+    for (auto &lambda : lambdas) {
+      qreg.swap(lambda);
+      be->qc_inverse(op);
+      qreg.swap(lambda);
+    }
+  }
+}
+
+void GradientEngine::add(const GradientEngine &eng) {
+  GradientEngine tmp(eng);
+  add(std::move(tmp));
+}
+
+void GradientEngine::add(GradientEngine &&eng) {
+  VectorEngine::add(std::move(eng));
+  // gradients are computed once by a single engine
+  if (output_gradients.empty()) {
+    output_gradients.swap(eng.output_gradients);
+    gradient_params.swap(eng.gradient_params);
+  }
+}
+
+/***************************************************************************/ /**
+  *
+  * JSON conversion
+  *
+  ******************************************************************************/
+
+inline void to_json(json_t &js, const GradientEngine &eng) {
+  const VectorEngine &vec_eng = eng;
+  to_json(js, vec_eng);
+  if (eng.show_gradients && eng.output_gradients.empty() == false) {
+    js["gradients"] = eng.output_gradients;
+    for (const auto &param : eng.gradient_params)
+      js["gradient_params"].push_back({param.first, param.second});
+  }
+}
+
+inline void from_json(const json_t &js, GradientEngine &eng) {
+  eng = GradientEngine();
+  VectorEngine &vec_eng = eng;
+  from_json(js, vec_eng);
+  // Get output options
+  std::vector<std::string> opts;
+  if (JSON::get_value(opts, "data", js)) {
+    for (auto &o : opts) {
+      to_lowercase(o);
+      string_trim(o);
+      if (o == "gradients")
+        eng.show_gradients = true;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+
+#endif
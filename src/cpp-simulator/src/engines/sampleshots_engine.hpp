@@ -23,6 +23,8 @@ limitations under the License.
 #ifndef _SampleShotsEngine_h_
 #define _SampleShotsEngine_h_
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 
@@ -44,15 +46,68 @@ public:
   // Default constructor
   SampleShotsEngine() : VectorEngine(2){};
 
+  void initialize(BaseBackend<cvector_t> *be, uint_t nthreads);
   void execute(Circuit &prog, BaseBackend<cvector_t> *be, uint_t nshots);
 
+  // Sampling is used if all measurements are at the end of the circuit and
+  // noise, if any, is confined to measurement readout
+  bool sample_measurements(const Circuit &prog,
+                           const BaseBackend<cvector_t> *be) const;
+
+  // Minimum number of shots or outcomes for which sampling is parallelized
+  uint_t sample_omp_threshold = 1ULL << 14;
+
 protected:
+  // Number of threads used for sampling measurement outcomes
+  uint_t omp_threads = 1;
+
   /**
    * Converts a complex vector into the diagonal of the equivalent density
    * matrix by v[i] = v[i]*conj(v[i]) then performs a partial trace over
    * subsystems potentially reducing the dimension of vector.
    */
   void partial_trace(std::set<uint_t> &trsys, cvector_t &qreg);
+
+  /**
+   * Returns the cumulative distribution of a vector of probabilities stored
+   * in the real part of a complex vector.
+   */
+  rvector_t cumulative_probs(const cvector_t &probs) const;
+
+  /**
+   * Samples measurement outcomes from a cumulative distribution. Each of the
+   * sampling threads uses an independent RNG stream seeded from rng.
+   */
+  std::vector<uint_t> sample_outcomes(const rvector_t &cdf, uint_t nshots,
+                                      RngEngine &rng) const;
+
+  /**
+   * Samples the histogram of measurement outcomes over all shots directly
+   * from a cumulative distribution by recursive binomial splitting. The cost
+   * is independent of the number of shots.
+   * @return a list of (outcome, number of shots) pairs with non-zero counts
+   */
+  std::vector<std::pair<uint_t, uint_t>>
+  sample_histogram(const rvector_t &cdf, uint_t nshots, RngEngine &rng) const;
+
+  /**
+   * Splits nshots samples over the outcomes in [first, last) by drawing the
+   * number falling in the lower half from a binomial distribution.
+   */
+  void split_shots(const rvector_t &cdf, uint_t first, uint_t last,
+                   uint_t nshots, RngEngine &rng,
+                   std::vector<std::pair<uint_t, uint_t>> &hist) const;
+
+  /**
+   * Records the counts for nshots shots with the same measurement outcome.
+   * If readout error is switched on the shots are split recursively over the
+   * recorded values of each measurement, starting from measurement pos.
+   * @param meas list of (clbit, outcome bit) pairs for each measurement
+   */
+  void record_counts(const Circuit &prog,
+                     const std::vector<std::pair<uint_t, uint_t>> &meas,
+                     uint_t outcome, uint_t pos, uint_t nshots,
+                     BaseBackend<cvector_t> *be);
 };
 
 /***************************************************************************/ /**
@@ -61,33 +116,45 @@ protected:
   *
   ******************************************************************************/
 
+void SampleShotsEngine::initialize(BaseBackend<cvector_t> *be,
+                                   uint_t nthreads) {
+  VectorEngine::initialize(be, nthreads);
+  omp_threads = std::max<uint_t>(1ULL, nthreads);
+}
+
+bool SampleShotsEngine::sample_measurements(
+    const Circuit &prog, const BaseBackend<cvector_t> *be) const {
+  return prog.opt_meas && be->noise.readout_only();
+}
+
 void SampleShotsEngine::execute(Circuit &prog, BaseBackend<cvector_t> *be,
                                 uint_t nshots) {
-  if (prog.opt_meas) {
+  if (sample_measurements(prog, be)) {
     // Find position of first measurement operation
     uint_t pos = 0;
-    while (prog.operations[pos].id != gate_t::Measure &&
-           pos < prog.operations.size()) {
+    while (pos < prog.operations.size() &&
+           prog.operations[pos].id != gate_t::Measure) {
       pos++;
     }
-    // store measurements
-    std::vector<operation> meas(prog.operations.begin() + pos,
-                                prog.operations.end());
-    // remove measurements from program and evaluate
-    prog.operations.resize(pos);
-    be->execute(prog); // execute gates without measurements
+    // execute gates without measurements, resuming the deterministic part
+    // from a cached checkpoint
+    const uint_t det = std::min(pos, be->deterministic_prefix(prog));
+    execute_prefix(prog, be, det);
+    be->execute_range(prog, det, pos);
     // Note that calling compute results here will give probabilities,
-    // state vectors, etc BEFORE measurement.
+    // state vectors, etc BEFORE measurement. Averaged state data is weighted
+    // by the number of shots it represents.
+    state_shots = nshots;
     VectorEngine::compute_results(prog, be);
+    state_shots = 1;
     // Clear creg results from shot without measurements
-    counts.clear();
-    output_creg.clear();
+    clear_counts();
 
     // Get set of measured qubits
     std::set<uint_t> qset;
-    for (const auto &op : meas)
-      qset.insert(op.qubits[0]);
-    const uint_t N = qset.size(); // number of measured qubits
+    for (auto it = prog.operations.cbegin() + pos; it != prog.operations.cend();
+         ++it)
+      qset.insert(it->qubits[0]);
 
     // find set of qubits not measured
     std::set<uint_t> qtr;
@@ -96,6 +163,14 @@ void SampleShotsEngine::execute(Circuit &prog, BaseBackend<cvector_t> *be,
         qtr.insert(j);
     }
 
+    // Bit of the sampled outcome recorded by each measurement as
+    // (clbit, position of the measured qubit in the sorted set qset)
+    std::vector<std::pair<uint_t, uint_t>> meas;
+    for (auto it = prog.operations.cbegin() + pos; it != prog.operations.cend();
+         ++it)
+      meas.push_back(std::make_pair(
+          it->clbits[0], std::distance(qset.begin(), qset.find(it->qubits[0]))));
+
     auto &rng = be->access_rng();
     auto &creg = be->access_creg();
     auto &qreg = be->access_qreg();
@@ -103,29 +178,22 @@ void SampleShotsEngine::execute(Circuit &prog, BaseBackend<cvector_t> *be,
     // trace over unmeasured qubits
     partial_trace(qtr, qreg);
 
-    // container for meas outcomes indexed by measured qubit
-    std::map<uint_t, uint_t> outcomes;
-    for (auto &q : qset)
-      outcomes[q] = 0;
-
-    // sample measurement outcomes
-    for (uint_t shot = 0; shot < nshots; shot++) {
-      double p = 0.;
-      double r = rng.rand(0, 1);
-      uint_t result;
-      for (result = 0; result < qreg.size(); result++) {
-        if (r < (p += std::real(qreg[result])))
-          break;
+    const rvector_t cdf = cumulative_probs(qreg);
+    if (show_final_creg) {
+      // sample measurement outcomes for each shot
+      const auto samples = sample_outcomes(cdf, nshots, rng);
+      for (const auto result : samples) {
+        // update creg with any readout error
+        for (const auto &m : meas)
+          creg[m.first] = be->measure_error((result >> m.second) & 1ULL);
+        // compute count based results
+        compute_counts(prog.clbit_labels, creg);
       }
-      // convert outcome to register
-      auto reg = int2reg(result, 2, N);
-      for (auto it = outcomes.cbegin(); it != outcomes.cend(); it++)
-        outcomes[it->first] = reg[std::distance(outcomes.cbegin(), it)];
-      // update creg
-      for (const auto &op : meas)
-        creg[op.clbits[0]] = outcomes[op.qubits[0]];
-      // compute count based results
-      compute_counts(prog.clbit_labels, creg);
+    } else {
+      // only counts are needed so sample the histogram of outcomes directly
+      const auto hist = sample_histogram(cdf, nshots, rng);
+      for (const auto &outcome : hist)
+        record_counts(prog, meas, outcome.first, 0, outcome.second, be);
     }
 
   } else {
@@ -135,6 +203,136 @@ void SampleShotsEngine::execute(Circuit &prog, BaseBackend<cvector_t> *be,
   }
 }
 
+rvector_t SampleShotsEngine::cumulative_probs(const cvector_t &probs) const {
+  const uint_t size = probs.size();
+  rvector_t cdf(size);
+  // Prefix sums are computed per block and then offset by the total of the
+  // preceding blocks
+  const uint_t nblocks =
+      (size >= sample_omp_threshold) ? std::min(omp_threads, size) : 1;
+  const uint_t block = (size + nblocks - 1) / nblocks;
+  rvector_t offsets(nblocks, 0.);
+#pragma omp parallel for if (nblocks > 1) num_threads(nblocks)
+  for (uint_t b = 0; b < nblocks; b++) {
+    const uint_t end = std::min(size, (b + 1) * block);
+    double p = 0.;
+    for (uint_t j = b * block; j < end; j++)
+      cdf[j] = (p += std::real(probs[j]));
+    offsets[b] = p;
+  }
+  if (nblocks > 1) {
+    double total = 0.;
+    for (auto &offset : offsets) {
+      const double block_total = offset;
+      offset = total;
+      total += block_total;
+    }
+#pragma omp parallel for num_threads(nblocks)
+    for (uint_t b = 1; b < nblocks; b++) {
+      const uint_t end = std::min(size, (b + 1) * block);
+      for (uint_t j = b * block; j < end; j++)
+        cdf[j] += offsets[b];
+    }
+  }
+  return cdf;
+}
+
+std::vector<uint_t> SampleShotsEngine::sample_outcomes(const rvector_t &cdf,
+                                                       uint_t nshots,
+                                                       RngEngine &rng) const {
+  std::vector<uint_t> samples(nshots);
+  const double norm = cdf.back();
+  const uint_t last = cdf.size() - 1;
+  auto sample = [&](RngEngine &r, uint_t first, uint_t end) {
+    for (uint_t shot = first; shot < end; shot++) {
+      const auto it = std::upper_bound(cdf.begin(), cdf.end(), r.rand(norm));
+      samples[shot] = std::min<uint_t>(std::distance(cdf.begin(), it), last);
+    }
+  };
+
+  const uint_t nstreams =
+      (nshots >= sample_omp_threshold) ? std::min(omp_threads, nshots) : 1;
+  if (nstreams < 2) {
+    sample(rng, 0, nshots);
+  } else {
+    // Seed an independent RNG stream for each block of shots
+    std::vector<RngEngine> streams;
+    for (uint_t j = 0; j < nstreams; j++)
+      streams.push_back(RngEngine(static_cast<uint_t>(
+          rng.rand_int(0, std::numeric_limits<int>::max()))));
+    const uint_t block = (nshots + nstreams - 1) / nstreams;
+#pragma omp parallel for num_threads(nstreams)
+    for (uint_t j = 0; j < nstreams; j++)
+      sample(streams[j], j * block, std::min(nshots, (j + 1) * block));
+  }
+  return samples;
+}
+
+std::vector<std::pair<uint_t, uint_t>>
+SampleShotsEngine::sample_histogram(const rvector_t &cdf, uint_t nshots,
+                                    RngEngine &rng) const {
+  std::vector<std::pair<uint_t, uint_t>> hist;
+  split_shots(cdf, 0, cdf.size(), nshots, rng, hist);
+  return hist;
+}
+
+void SampleShotsEngine::split_shots(
+    const rvector_t &cdf, uint_t first, uint_t last, uint_t nshots,
+    RngEngine &rng, std::vector<std::pair<uint_t, uint_t>> &hist) const {
+  if (nshots == 0)
+    return;
+  if (last - first == 1) {
+    hist.push_back(std::make_pair(first, nshots));
+    return;
+  }
+  const uint_t mid = (first + last) / 2;
+  const double base = (first > 0) ? cdf[first - 1] : 0.;
+  const double p_lower = cdf[mid - 1] - base;
+  const double p_total = cdf[last - 1] - base;
+  const double p = (p_total > 0.) ? std::min(1., std::max(0., p_lower / p_total))
+                                  : 0.5;
+  const uint_t nlower = rng.rand_binomial(nshots, p);
+  split_shots(cdf, first, mid, nlower, rng, hist);
+  split_shots(cdf, mid, last, nshots - nlower, rng, hist);
+}
+
+void SampleShotsEngine::record_counts(
+    const Circuit &prog, const std::vector<std::pair<uint_t, uint_t>> &meas,
+    uint_t outcome, uint_t pos, uint_t nshots, BaseBackend<cvector_t> *be) {
+  if (nshots == 0)
+    return;
+  auto &creg = be->access_creg();
+  if (pos == meas.size()) {
+    compute_counts(prog.clbit_labels, creg, nshots);
+    return;
+  }
+  const uint_t clbit = meas[pos].first;
+  const uint_t bit = (outcome >> meas[pos].second) & 1ULL;
+  if (be->readout_error() == false || bit >= be->noise.readout.p.size()) {
+    creg[clbit] = bit;
+    record_counts(prog, meas, outcome, pos + 1, nshots, be);
+    return;
+  }
+  // Split the shots over the recorded values using the assignment
+  // probabilities P(k|bit) of the readout error
+  const auto probs = be->noise.readout.p[bit].probabilities();
+  auto &rng = be->access_rng();
+  uint_t remaining = nshots;
+  double p_remaining = 1.;
+  for (uint_t k = 0; k < probs.size() && remaining > 0; k++) {
+    uint_t nk = remaining;
+    if (k + 1 < probs.size())
+      nk = (p_remaining > 0.)
+               ? rng.rand_binomial(remaining,
+                                   std::min(1., probs[k] / p_remaining))
+               : 0;
+    p_remaining -= probs[k];
+    remaining -= nk;
+    creg[clbit] = k;
+    record_counts(prog, meas, outcome, pos + 1, nk, be);
+  }
+}
+
 void SampleShotsEngine::partial_trace(std::set<uint_t> &trsys,
                                       cvector_t &qreg) {
   // Convert qreg to probability
@@ -29,12 +29,62 @@ limitations under the License.
 //#include "state_results.hpp"
 #include "base_engine.hpp"
 #include "misc.hpp"
+#include "npy.hpp"
+#include "pauli_observable.hpp"
+#include "shm.hpp"
 
 // SAVED PROBABILITIES BROKEN
 // SAVED PROB KET BROKEN
 
 namespace QISKIT {
 
+/***************************************************************************/ /**
+ *
+ * DensityAccumulator class
+ *
+ * Accumulates a weighted sum of pure state projectors sum_k w_k |psi_k><psi_k|
+ * in the upper triangle of a Hermitian matrix. States are buffered as the
+ * columns of a block which is added by a single rank-k update (zherk), and
+ * consecutive identical states are buffered once with an increased weight.
+ *
+ ******************************************************************************/
+
+class DensityAccumulator {
+public:
+  uint_t block_size = 16; // number of buffered states per rank-k update
+
+  // Add a weighted state projector
+  void add(const cvector_t &psi, double weight = 1.);
+
+  // Add the matrix accumulated by another accumulator
+  void add(DensityAccumulator &&acc);
+  DensityAccumulator &operator+=(const DensityAccumulator &acc) {
+    DensityAccumulator tmp(acc);
+    add(std::move(tmp));
+    return *this;
+  };
+  DensityAccumulator &operator+=(DensityAccumulator &&acc) {
+    add(std::move(acc));
+    return *this;
+  };
+
+  // Add any buffered states to the accumulated matrix
+  void flush();
+
+  // Returns true if no states have been added
+  inline bool empty() const { return rho_.size() == 0 && count_ == 0; };
+
+  // Returns the full Hermitian matrix multiplied by a scalar. Buffered states
+  // must be flushed first.
+  cmatrix_t matrix(double scale) const;
+
+private:
+  cmatrix_t rho_;   // upper triangle of the accumulated matrix
+  cmatrix_t block_; // buffered states as columns
+  rvector_t weights_;
+  uint_t count_ = 0; // number of buffered states
+};
+
 /***************************************************************************/ /**
  *
  * VectorEngine class
@@ -53,6 +103,8 @@ namespace QISKIT {
  *   of the system for each shot.
  * - The expectation values of a set  of target states of the final or saved
  *   states of the system averaged over shots.
+ * - The expectation values of a set of Pauli observables of the final or
+ *   saved states of the system averaged over shots.
  *
  ******************************************************************************/
 
@@ -74,6 +126,7 @@ public:
   bool show_final_probs_ket = false; // return final state probs
   bool show_final_inner_product = false; // compute ip with targ states
   bool show_final_overlaps = false;      // compute overlaps with target states
+  bool show_final_expvals = false;       // compute observable expectations
 
   bool show_saved_ket = false;           // record saved states
   bool show_saved_density = false;       // record saved density matrices
@@ -81,30 +134,34 @@ public:
   bool show_saved_probs_ket = false;     // record saved density matrices
   bool show_saved_inner_product = false; // compute ip with targ states
   bool show_saved_overlaps = false;      // compute overlaps with target states
+  bool show_saved_expvals = false;       // compute observable expectations
 
-  std::vector<cvector_t> target_states; // vector of target states
+  std::vector<cvector_t> target_states;     // vector of target states
+  std::vector<PauliObservable> observables; // vector of Pauli observables
 
   //============================================================================
   // Results / Data
   //============================================================================
 
   // Final state output data
-  std::vector<cket_t> output_ket; // quantum state ket
-  cmatrix_t output_density;       // density matrix over all shots
+  std::vector<cket_t> output_ket;  // quantum state ket
+  DensityAccumulator output_density; // density matrix over all shots
   rvector_t output_probs;         // probability vec over all shots
   std::map<std::string, double>
       output_probs_ket; // probability ket over all shots
 
   std::vector<cvector_t> output_inprods; // inner products with target states
   rvector_t output_overlaps;             // average overlaps with target states
+  rvector_t output_expvals;              // average observable expectations
 
   // Saved states output data
   std::vector<std::map<uint_t, cket_t>> saved_ket;
-  std::map<uint_t, cmatrix_t> saved_density;
+  std::map<uint_t, DensityAccumulator> saved_density;
   std::map<uint_t, rvector_t> saved_probs;
   std::map<uint_t, std::map<std::string, double>> saved_probs_ket;
   std::map<uint_t, std::vector<cvector_t>> saved_inprods;
   std::map<uint_t, rvector_t> saved_overlaps;
+  std::map<uint_t, rvector_t> saved_expvals;
 
   //============================================================================
   // Methods
@@ -113,74 +170,198 @@ public:
   // Adds results data from another engine.
   void add(const VectorEngine &eng);
 
+  // Adds results data from another engine by moving its containers. The
+  // results of eng are left in an unspecified state.
+  void add(VectorEngine &&eng);
+
   // Overloads the += operator to combine the results of different engines
   VectorEngine &operator+=(const VectorEngine &eng) {
     add(eng);
     return *this;
   };
+  VectorEngine &operator+=(VectorEngine &&eng) {
+    add(std::move(eng));
+    return *this;
+  };
+
+  // Runs the shots and flushes any buffered density matrix states
+  void run_program(Circuit &circ, BaseBackend<cvector_t> *be,
+                   uint_t nshots = 1, uint_t nthreads = 1);
 
   // Compute results
   void compute_results(Circuit &circ, BaseBackend<cvector_t> *be);
 
+  // Returns true if any final or saved state data is requested
+  inline bool show_state_data() const {
+    return show_final_qreg || show_saved_qreg || show_final_ket ||
+           show_final_density || show_final_probs || show_final_probs_ket ||
+           show_final_inner_product || show_final_overlaps ||
+           show_final_expvals || show_saved_ket || show_saved_density ||
+           show_saved_probs || show_saved_probs_ket ||
+           show_saved_inner_product || show_saved_overlaps ||
+           show_saved_expvals;
+  };
+
+  // Compute the expectation values of all observables for a state
+  rvector_t expectation_values(const cvector_t &psi, uint_t nthreads) const;
+
   // Convert a complex vector or ket to a real one
   double get_probs(const complex_t &val) const;
   rvector_t get_probs(const cvector_t &vec) const;
   std::map<std::string, double> get_probs(const cket_t &ket) const;
+
+protected:
+  // Number of shots represented by the state passed to compute_results. This
+  // is used to weight averaged state data when a single state is used for
+  // all shots.
+  uint_t state_shots = 1;
 };
 
+/***************************************************************************/ /**
+  *
+  * DensityAccumulator methods
+  *
+  ******************************************************************************/
+
+void DensityAccumulator::add(const cvector_t &psi, double weight) {
+  const size_t dim = psi.size();
+  // merge with the previous state if it is identical
+  if (count_ > 0 && block_.GetRows() == dim &&
+      std::equal(psi.cbegin(), psi.cend(),
+                 block_.GetMat() + (count_ - 1) * dim)) {
+    weights_[count_ - 1] += weight;
+    return;
+  }
+  if (count_ == block_size ||
+      (count_ > 0 && block_.GetRows() != dim))
+    flush();
+  if (block_.GetRows() != dim || block_.GetColumns() != block_size) {
+    block_ = cmatrix_t(dim, block_size);
+    weights_.assign(block_size, 0.);
+  }
+  std::copy(psi.cbegin(), psi.cend(), block_.GetMat() + count_ * dim);
+  weights_[count_] = weight;
+  count_++;
+}
+
+void DensityAccumulator::flush() {
+  if (count_ == 0)
+    return;
+  const size_t dim = block_.GetRows();
+  const size_t k = count_;
+  complex_t *cols = block_.GetMat();
+  for (size_t j = 0; j < k; j++) {
+    const double w = std::sqrt(weights_[j]);
+    for (size_t i = 0; i < dim; i++)
+      cols[j * dim + i] *= w;
+  }
+  const double alpha = 1.;
+  const double beta = (rho_.size() == 0) ? 0. : 1.;
+  if (rho_.size() == 0)
+    rho_ = cmatrix_t(dim, dim);
+  else if (rho_.GetRows() != dim)
+    throw std::runtime_error("density matrix states have different sizes");
+  const char uplo = 'U', trans = 'N';
+  zherk_(&uplo, &trans, &dim, &k, &alpha, cols, &dim, &beta, rho_.GetMat(),
+         &dim);
+  count_ = 0;
+}
+
+void DensityAccumulator::add(DensityAccumulator &&acc) {
+  acc.flush();
+  flush();
+  if (rho_.size() == 0)
+    rho_ = std::move(acc.rho_);
+  else if (acc.rho_.size() > 0)
+    rho_ += acc.rho_;
+}
+
+cmatrix_t DensityAccumulator::matrix(double scale) const {
+  const size_t dim = rho_.GetRows();
+  cmatrix_t ret(dim, dim);
+  for (size_t j = 0; j < dim; j++)
+    for (size_t i = 0; i <= j; i++) {
+      const complex_t val = scale * rho_(i, j);
+      ret(i, j) = val;
+      ret(j, i) = std::conj(val);
+    }
+  return ret;
+}
+
 /***************************************************************************/ /**
   *
   * VectorEngine methods
   *
   ******************************************************************************/
 
+void VectorEngine::run_program(Circuit &prog, BaseBackend<cvector_t> *be,
+                               uint_t nshots, uint_t nthreads) {
+  BaseEngine<cvector_t>::run_program(prog, be, nshots, nthreads);
+  output_density.flush();
+  for (auto &save : saved_density)
+    save.second.flush();
+}
+
 void VectorEngine::add(const VectorEngine &eng) {
+  VectorEngine tmp(eng);
+  add(std::move(tmp));
+}
+
+void VectorEngine::add(VectorEngine &&eng) {
 
-  BaseEngine<cvector_t>::add(eng);
+  BaseEngine<cvector_t>::add(std::move(eng));
 
   /* Accumulated output state data */
 
-  // copy output ket-maps
-  std::copy(eng.output_ket.begin(), eng.output_ket.end(),
-            back_inserter(output_ket));
+  // move output ket-maps
+  move_append(output_ket, eng.output_ket);
 
-  // copy inner products
-  std::copy(eng.output_inprods.begin(), eng.output_inprods.end(),
-            back_inserter(output_inprods));
+  // move inner products
+  move_append(output_inprods, eng.output_inprods);
 
   // Add overlaps
-  output_overlaps += eng.output_overlaps;
+  if (output_overlaps.empty())
+    output_overlaps.swap(eng.output_overlaps);
+  else
+    output_overlaps += eng.output_overlaps;
+
+  // Add expectation values (not normalized)
+  if (output_expvals.empty())
+    output_expvals.swap(eng.output_expvals);
+  else
+    output_expvals += eng.output_expvals;
 
   // Add output probs ket (not normalized)
-  output_probs_ket += eng.output_probs_ket;
+  if (output_probs_ket.empty())
+    output_probs_ket.swap(eng.output_probs_ket);
+  else
+    output_probs_ket += eng.output_probs_ket;
 
   // Add probs (not normalized)
-  output_probs += eng.output_probs;
+  if (output_probs.empty())
+    output_probs.swap(eng.output_probs);
+  else
+    output_probs += eng.output_probs;
 
   // Add density matrices (not normalized)
-  if (output_density.size() == 0)
-    output_density = eng.output_density;
-  else
-    output_density += eng.output_density;
+  output_density += std::move(eng.output_density);
 
   /* Accumulated saved states Data */
 
-  // copy saved ket-maps
-  std::copy(eng.saved_ket.begin(), eng.saved_ket.end(),
-            back_inserter(saved_ket));
+  // move saved ket-maps
+  move_append(saved_ket, eng.saved_ket);
 
   // Add saved density
-  for (const auto &save : eng.saved_density) {
-    auto &rho = saved_density[save.first];
-    if (rho.size() == 0)
-      rho = save.second;
-    else
-      rho += save.second;
-  }
+  for (auto &save : eng.saved_density)
+    saved_density[save.first] += std::move(save.second);
 
   // Add saved probs
-  for (const auto &save : eng.saved_probs) {
-    saved_probs[save.first] += save.second;
+  for (auto &save : eng.saved_probs) {
+    auto &pr = saved_probs[save.first];
+    if (pr.empty())
+      pr.swap(save.second);
+    else
+      pr += save.second;
   }
 
   // Add saved probs ket
@@ -191,10 +372,13 @@ void VectorEngine::add(const VectorEngine &eng) {
   for (const auto &save : eng.saved_overlaps)
     saved_overlaps[save.first] += save.second;
 
-  // copy saved inner prods
-  for (const auto &save : eng.saved_inprods)
-    std::copy(save.second.begin(), save.second.end(),
-              back_inserter(saved_inprods[save.first]));
+  // Add saved expectation values
+  for (const auto &save : eng.saved_expvals)
+    saved_expvals[save.first] += save.second;
+
+  // move saved inner prods
+  for (auto &save : eng.saved_inprods)
+    move_append(saved_inprods[save.first], save.second);
 }
 
 //------------------------------------------------------------------------------
@@ -239,15 +423,17 @@ void VectorEngine::compute_results(Circuit &qasm, BaseBackend<cvector_t> *be) {
       output_inprods.push_back(inprods);
     // Add output overlaps (needs renormalizing at output)
     if (show_final_overlaps)
-      output_overlaps += get_probs(inprods);
+      output_overlaps += get_probs(inprods) * state_shots;
   }
 
+  // Expectation values (needs renormalizing at output)
+  if (show_final_expvals && observables.empty() == false)
+    output_expvals +=
+        expectation_values(qreg, be->get_omp_threads()) * state_shots;
+
   // Density matrix (needs renormalizing at output)
-  if (show_final_density) {
-    const uint_t m = qreg.size();
-    output_density.resize(m, m);
-    output_density += outer_product(qreg, qreg);
-  }
+  if (show_final_density)
+    output_density.add(qreg, state_shots);
 
   // Final probabilities (needs renormalizing at output)
   if (show_final_probs) {
@@ -255,7 +441,7 @@ void VectorEngine::compute_results(Circuit &qasm, BaseBackend<cvector_t> *be) {
     for (uint_t j = 0; j < qreg.size(); j++) {
       double val = get_probs(qreg[j]);
       if (val > epsilon)
-        output_probs[j] += val;
+        output_probs[j] += val * state_shots;
     }
   }
 
@@ -265,7 +451,7 @@ void VectorEngine::compute_results(Circuit &qasm, BaseBackend<cvector_t> *be) {
     // Final probabilities (needs renormalizing at output)
     if (show_final_probs)
       for (const auto &q : qregket)
-        output_probs_ket[q.first] += get_probs(q.second);
+        output_probs_ket[q.first] += get_probs(q.second) * state_shots;
     // Final state ket vectors
     if (show_final_ket)
       output_ket.push_back(qregket);
@@ -287,20 +473,15 @@ void VectorEngine::compute_results(Circuit &qasm, BaseBackend<cvector_t> *be) {
         for (const auto &save : km) {
           rket_t tmp;
           for (const auto &vals : save.second)
-            tmp[vals.first] = get_probs(vals.second);
+            tmp[vals.first] = get_probs(vals.second) * state_shots;
           saved_probs_ket[save.first] += tmp;
         }
     }
 
     // add density matrix (needs renormalizing after all shots)
     if (show_saved_density) {
-      for (auto const &psi : qreg_saved) {
-        cmatrix_t &rho = saved_density[psi.first];
-        if (rho.size() == 0)
-          rho = outer_product(psi.second, psi.second);
-        else
-          rho = rho + outer_product(psi.second, psi.second);
-      }
+      for (auto const &psi : qreg_saved)
+        saved_density[psi.first].add(psi.second, state_shots);
     }
 
     // add probs (needs renormalizing after all shots)
@@ -308,11 +489,19 @@ void VectorEngine::compute_results(Circuit &qasm, BaseBackend<cvector_t> *be) {
       for (auto const &psi : qreg_saved) {
         auto &pr = saved_probs[psi.first];
         if (pr.empty())
-          pr = get_probs(psi.second);
+          pr = get_probs(psi.second) * state_shots;
         else
-          pr += get_probs(psi.second);
+          pr += get_probs(psi.second) * state_shots;
       }
     }
+
+    // add expectation values (needs renormalizing after all shots)
+    if (show_saved_expvals && observables.empty() == false) {
+      for (auto const &psi : qreg_saved)
+        saved_expvals[psi.first] +=
+            expectation_values(psi.second, be->get_omp_threads()) *
+            state_shots;
+    }
     // Inner products
     if (target_states.empty() == false &&
         (show_saved_inner_product || show_saved_overlaps)) {
@@ -338,12 +527,24 @@ void VectorEngine::compute_results(Circuit &qasm, BaseBackend<cvector_t> *be) {
           saved_inprods[save.first].push_back(inprods);
         // Add output overlaps (needs renormalizing at output)
         if (show_saved_overlaps)
-          saved_overlaps[save.first] += get_probs(inprods);
+          saved_overlaps[save.first] += get_probs(inprods) * state_shots;
       }
     }
   }
 }
 
+//------------------------------------------------------------------------------
+rvector_t VectorEngine::expectation_values(const cvector_t &psi,
+                                           uint_t nthreads) const {
+  rvector_t vals;
+  for (const auto &obs : observables) {
+    double val = obs.expectation_value(psi, nthreads);
+    chop(val, epsilon);
+    vals.push_back(val);
+  }
+  return vals;
+}
+
 //------------------------------------------------------------------------------
 double VectorEngine::get_probs(const complex_t &val) const {
   return std::real(std::conj(val) * val);
@@ -378,6 +579,49 @@ inline void to_json(json_t &js, const VectorEngine &eng) {
   // renormalization constant for average over shots
   double renorm = 1. / eng.total_shots;
 
+  // State data is written to .npy files named by this prefix if it is set
+  const std::string &binary = eng.output_binary;
+
+  // State vectors are copied to shared memory segments named by this prefix
+  // if it is set, which takes precedence over binary files
+  const std::string &shm = eng.output_shm;
+
+  if (eng.show_final_qreg && eng.output_qreg.empty() == false) {
+    if (shm.empty() == false)
+      js["quantum_states"] =
+          SHM::save(shm + "_quantum_states", eng.output_qreg);
+    else if (binary.empty() == false)
+      js["quantum_states"] =
+          NPY::save(binary + "_quantum_states.npy", eng.output_qreg);
+  }
+
+  // Saved states of each save index are exported as rows of the shots that
+  // saved them
+  if ((shm.empty() == false || binary.empty() == false) &&
+      eng.show_saved_qreg && eng.saved_qreg.empty() == false) {
+    std::map<uint_t, std::vector<const complex_t *>> rows;
+    std::map<uint_t, uint_t> cols;
+    for (const auto &shot : eng.saved_qreg)
+      for (const auto &save : shot) {
+        if (cols.count(save.first) > 0 &&
+            cols[save.first] != save.second.size())
+          throw std::runtime_error("saved states have different lengths");
+        cols[save.first] = save.second.size();
+        rows[save.first].push_back(save.second.data());
+      }
+    json_t saved = json_t::object();
+    for (const auto &save : rows) {
+      const std::string k = std::to_string(save.first);
+      if (shm.empty() == false)
+        saved[k] = SHM::save(shm + "_saved_quantum_states_" + k, save.second,
+                             cols[save.first]);
+      else
+        saved[k] = NPY::save(binary + "_saved_quantum_states_" + k + ".npy",
+                             save.second, cols[save.first]);
+    }
+    js["saved_quantum_states"] = saved;
+  }
+
   // add inner products
   if (eng.show_final_inner_product && eng.output_inprods.empty() == false) {
     auto tmp = eng.output_inprods;
@@ -391,6 +635,12 @@ inline void to_json(json_t &js, const VectorEngine &eng) {
     js["overlaps"] = tmp;
   }
 
+  if (eng.show_final_expvals && eng.output_expvals.empty() == false) {
+    auto tmp = eng.output_expvals * renorm;
+    chop(tmp, eng.epsilon);
+    js["expectation_values"] = tmp;
+  }
+
   // renormalize probs
   if (eng.show_final_probs && eng.output_probs.empty() == false) {
     rvector_t probs;
@@ -398,7 +648,10 @@ inline void to_json(json_t &js, const VectorEngine &eng) {
       double p = ps * renorm;
       probs.push_back((p < eng.epsilon) ? 0 : p);
     }
-    js["probabilities"] = probs;
+    if (binary.empty())
+      js["probabilities"] = probs;
+    else
+      js["probabilities"] = NPY::save(binary + "_probabilities.npy", probs);
   }
 
   // renormalize probs ket
@@ -415,10 +668,13 @@ inline void to_json(json_t &js, const VectorEngine &eng) {
   }
 
   // renormalize density
-  if (eng.show_final_density && eng.output_density.size() > 0) {
-    cmatrix_t rho = eng.output_density * renorm;
+  if (eng.show_final_density && eng.output_density.empty() == false) {
+    cmatrix_t rho = eng.output_density.matrix(renorm);
     chop(rho, eng.epsilon);
-    js["density_matrix"] = rho;
+    if (binary.empty())
+      js["density_matrix"] = rho;
+    else
+      js["density_matrix"] = NPY::save(binary + "_density_matrix.npy", rho);
   }
 
   // Saved kets
@@ -429,12 +685,21 @@ inline void to_json(json_t &js, const VectorEngine &eng) {
   // Saved density
   if (eng.show_saved_density && eng.saved_density.empty() == false) {
     std::map<uint_t, cmatrix_t> saved_rhos;
+    json_t saved_files = json_t::object();
     for (const auto &save : eng.saved_density) {
-      auto rho = save.second * renorm;
+      auto rho = save.second.matrix(renorm);
       chop(rho, eng.epsilon);
-      saved_rhos[save.first] = rho;
+      const std::string k = std::to_string(save.first);
+      if (binary.empty())
+        saved_rhos[save.first] = rho;
+      else
+        saved_files[k] =
+            NPY::save(binary + "_saved_density_matrix_" + k + ".npy", rho);
     }
-    js["saved_density_matrix"] = saved_rhos;
+    if (binary.empty())
+      js["saved_density_matrix"] = saved_rhos;
+    else
+      js["saved_density_matrix"] = saved_files;
   }
   // Saved probs
   if (eng.show_saved_probs && eng.saved_probs.empty() == false) {
@@ -444,7 +709,17 @@ inline void to_json(json_t &js, const VectorEngine &eng) {
       ret[save.first] = val * renorm;
       chop(ret[save.first], eng.epsilon);
     }
-    js["saved_probabilities"] = ret;
+    if (binary.empty())
+      js["saved_probabilities"] = ret;
+    else {
+      json_t saved_files = json_t::object();
+      for (const auto &save : ret) {
+        const std::string k = std::to_string(save.first);
+        saved_files[k] = NPY::save(
+            binary + "_saved_probabilities_" + k + ".npy", save.second);
+      }
+      js["saved_probabilities"] = saved_files;
+    }
   }
   // Saved probs ket
   if (eng.show_saved_probs_ket && eng.saved_probs_ket.empty() == false) {
@@ -473,6 +748,15 @@ inline void to_json(json_t &js, const VectorEngine &eng) {
     }
     js["saved_overlaps"] = tmp;
   }
+  // Saved expectation values
+  if (eng.show_saved_expvals && eng.saved_expvals.empty() == false) {
+    auto tmp = eng.saved_expvals;
+    for (auto &save : tmp) {
+      save.second *= renorm;
+      chop(save.second, eng.epsilon);
+    }
+    js["saved_expectation_values"] = tmp;
+  }
 }
 
 inline void from_json(const json_t &js, VectorEngine &eng) {
@@ -498,6 +782,8 @@ inline void from_json(const json_t &js, VectorEngine &eng) {
         eng.show_final_inner_product = true;
       else if (o == "targetstatesprobs")
         eng.show_final_overlaps = true;
+      else if (o == "expectationvalues")
+        eng.show_final_expvals = true;
 
       else if (o == "savedquantumstateket" || o == "savedquantumstatesket")
         eng.show_saved_ket = true;
@@ -511,6 +797,8 @@ inline void from_json(const json_t &js, VectorEngine &eng) {
         eng.show_saved_inner_product = true;
       else if (o == "savedtargetstatesprobs")
         eng.show_saved_overlaps = true;
+      else if (o == "savedexpectationvalues")
+        eng.show_saved_expvals = true;
     }
   }
   // Get additional settings
@@ -528,6 +816,9 @@ inline void from_json(const json_t &js, VectorEngine &eng) {
       renorm_target_states)
     for (auto &v : eng.target_states)
       renormalize(v);
+
+  // parse Pauli observables from JSON
+  JSON::get_value(eng.observables, "observables", js);
 }
 
 //------------------------------------------------------------------------------
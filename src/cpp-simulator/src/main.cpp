@@ -23,10 +23,16 @@ limitations under the License.
 //#define DEBUG // Uncomment for verbose debugging output
 
 #include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 
 // Simulator
+#include "pipeline.hpp"
+#include "qobj_binary.hpp"
+#include "qobj_reader.hpp"
+#include "server.hpp"
 #include "simulator.hpp"
 
 /*******************************************************************************
@@ -48,11 +54,43 @@ int main(int argc, char **argv) {
   std::ostream &out = std::cout; // output stream
   int indent = 4;
   json_t qobj;
+  std::ifstream file;
+  std::istream *in = &std::cin;
 
-  // Parse the input from cin or stream
+  // Serve qobjs on a Unix domain socket
+  if (argc == 3 && std::string(argv[1]) == "--server") {
+    try {
+      QISKIT::Server server(argv[2]);
+      server.run();
+      return 0;
+    } catch (std::exception &e) {
+      failed(e.what(), out, indent);
+      return 1;
+    }
+  }
+
+  // Parse the input from cin or stream up to its circuits, which are read
+  // one at a time by the pipeline. Binary qobj files are memory mapped.
+  std::unique_ptr<QISKIT::QobjReader> reader;
+  std::unique_ptr<QISKIT::BinaryQobj> binary;
   if (argc == 2) {
     try {
-      qobj = JSON::load(std::string(argv[1]));
+      const std::string name(argv[1]);
+      if (name != "-" && name != "stdin" &&
+          QISKIT::BinaryQobj::is_binary(name)) {
+        binary.reset(new QISKIT::BinaryQobj(name));
+        qobj = binary->header();
+      } else {
+        if (name != "-" && name != "stdin") {
+          file.open(name);
+          if (file.is_open() == false)
+            throw std::runtime_error(
+                std::string("no such file or directory"));
+          in = &file;
+        }
+        reader.reset(new QISKIT::QobjReader(*in));
+        qobj = reader->read_header();
+      }
     } catch (std::exception &e) {
       std::stringstream msg;
       msg << "Invalid input (" << e.what() << ")";
@@ -64,14 +102,19 @@ int main(int argc, char **argv) {
     // Print usage message
     std::cerr << std::endl;
     std::cerr << "qsikit_simulator file" << std::endl;
+    std::cerr << "qsikit_simulator --server socket" << std::endl;
     std::cerr << std::endl;
-    std::cerr << "  file : qobj file\n" << std::endl;
+    std::cerr << "  file : qobj file" << std::endl;
+    std::cerr << "  socket : Unix domain socket path to serve qobjs on\n"
+              << std::endl;
     return 1;
   }
 
-  // Execute simulation
+  // Execute simulation. Circuits are parsed while earlier ones are simulated.
   try {
-    QISKIT::Simulator sim = qobj;
+    QISKIT::Simulator sim;
+    sim.load_circuits = false;
+    from_json(qobj, sim);
 
 // Set qubit limit
 #if defined MAX_QUBITS
@@ -79,7 +122,12 @@ int main(int argc, char **argv) {
 #endif
 
     // Execute
-    out << sim.execute().dump(indent) << std::endl;
+    if (binary)
+      QISKIT::Pipeline().execute(sim, *binary, out, indent);
+    else if (reader->streaming())
+      QISKIT::Pipeline().execute(sim, *reader, out, indent);
+    else
+      QISKIT::Pipeline().execute(sim, qobj, out, indent);
     return 0;
   } catch (std::exception &e) {
     std::stringstream msg;
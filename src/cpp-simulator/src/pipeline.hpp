@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    pipeline.hpp
+ * @brief   Pipelined parsing, simulation and output of the circuits of a qobj
+ */
+
+#ifndef _Pipeline_hpp_
+#define _Pipeline_hpp_
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "bounded_queue.hpp"
+#include "qobj_binary.hpp"
+#include "qobj_reader.hpp"
+#include "simulator.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * Pipeline class
+  *
+  * Executes the circuits of a qobj in three overlapping stages connected by
+  * bounded queues: a parser thread constructs each Circuit, either from its
+  * JSON, which it then releases, or directly from a QobjReader or BinaryQobj,
+  * the calling thread simulates the circuits in qobj order, and a writer
+  * thread collects the results. For streamed output the writer serializes
+  * each result and writes its line while the next circuit is simulated,
+  * otherwise the output is written once the last circuit has run. The output
+  * is the same as that of Simulator::execute. If a circuit cannot be parsed
+  * the circuits before it are still run, and the qobj fails with the parse
+  * error.
+  *
+  * Prefix sharing orders the circuits by their operations, so qobjs that
+  * request it are parsed completely before they are simulated, and then only
+  * the circuits before one that cannot be parsed are run.
+  *
+  ******************************************************************************/
+
+class Pipeline {
+public:
+  /**
+   * Constructs a pipeline.
+   * @param depth: the number of parsed circuits and of unwritten results
+   *               held between the stages.
+   */
+  explicit Pipeline(uint_t depth = 2) : depth_(depth){};
+
+  /**
+   * Executes a qobj and writes its output.
+   * @param sim: a simulator loaded from the qobj with load_circuits false.
+   * @param qobj: the qobj, whose circuits are released once parsed.
+   * @param out: the output stream.
+   * @param indent: the indentation of non-streamed output, or -1 for none.
+   */
+  void execute(Simulator &sim, json_t &qobj, std::ostream &out,
+               int indent = -1) const;
+
+  /**
+   * Executes a qobj whose circuits are streamed by a reader.
+   * @param sim: a simulator loaded from the qobj header of the reader.
+   * @param reader: the reader, positioned at the first circuit.
+   * @param out: the output stream.
+   * @param indent: the indentation of non-streamed output, or -1 for none.
+   */
+  void execute(Simulator &sim, QobjReader &reader, std::ostream &out,
+               int indent = -1) const;
+
+  /**
+   * Executes a binary qobj.
+   * @param sim: a simulator loaded from the header of the qobj.
+   * @param qobj: the mapped binary qobj.
+   * @param out: the output stream.
+   * @param indent: the indentation of non-streamed output, or -1 for none.
+   */
+  void execute(Simulator &sim, BinaryQobj &qobj, std::ostream &out,
+               int indent = -1) const;
+
+private:
+  uint_t depth_;
+
+  // Sets the next circuit of a qobj and its result key, or returns false
+  // after the last circuit
+  using source_t = std::function<bool(Circuit &, std::string &)>;
+
+  struct Job {
+    uint_t index;
+    Circuit circ;
+    std::string result_key;
+  };
+
+  // Stream buffer that writes each flushed line to a shared stream under a
+  // lock, so that lines written by different stages are not interleaved
+  class LineBuffer : public std::stringbuf {
+  public:
+    LineBuffer(std::ostream &out, std::mutex &mutex)
+        : out_(out), mutex_(mutex){};
+    ~LineBuffer() { sync(); };
+
+  protected:
+    int sync() override;
+
+  private:
+    std::ostream &out_;
+    std::mutex &mutex_;
+  };
+
+  void run(Simulator &sim, const source_t &next, std::ostream &out,
+           int indent) const;
+
+  // Loads and executes all circuits before writing the output
+  void execute_all(Simulator &sim, const source_t &next, std::ostream &out,
+                   int indent) const;
+};
+
+/*******************************************************************************
+ *
+ * Pipeline methods
+ *
+ ******************************************************************************/
+
+void Pipeline::execute(Simulator &sim, json_t &qobj, std::ostream &out,
+                       int indent) const {
+  json_t &circs = qobj["circuits"];
+  uint_t j = 0;
+  run(sim,
+      [&](Circuit &circ, std::string &result_key) {
+        if (j == circs.size())
+          return false;
+        circ = sim.load_circuit(circs[j], result_key);
+        circs[j++].clear();
+        return true;
+      },
+      out, indent);
+}
+
+void Pipeline::execute(Simulator &sim, QobjReader &reader, std::ostream &out,
+                       int indent) const {
+  run(sim,
+      [&](Circuit &circ, std::string &result_key) {
+        return reader.next_circuit(sim, circ, result_key);
+      },
+      out, indent);
+}
+
+void Pipeline::execute(Simulator &sim, BinaryQobj &qobj, std::ostream &out,
+                       int indent) const {
+  run(sim,
+      [&](Circuit &circ, std::string &result_key) {
+        return qobj.next_circuit(sim, circ, result_key);
+      },
+      out, indent);
+}
+
+void Pipeline::run(Simulator &sim, const source_t &next, std::ostream &out,
+                   int indent) const {
+  if (sim.prefix_sharing && sim.simulator != "clifford") {
+    execute_all(sim, next, out, indent);
+    return;
+  }
+
+  const auto start = myclock_t::now();
+  json_t output;
+  output["id"] = sim.id;
+  if (sim.simulator == "clifford")
+    output["backend"] = std::string("local_clifford_simulator");
+  else
+    output["backend"] = std::string("local_qiskit_simulator");
+  output["simulator"] = sim.simulator;
+  std::mutex out_mutex;
+  if (sim.stream_output) {
+    out << output.dump() << std::endl;
+    output = json_t::object();
+  }
+
+  // Parse stage
+  BoundedQueue<Job> parsed(depth_);
+  std::string parse_error;
+  std::thread parser([&]() {
+    try {
+      Job job;
+      for (job.index = 0; next(job.circ, job.result_key); job.index++)
+        if (parsed.push(std::move(job)) == false)
+          break;
+    } catch (std::exception &e) {
+      parse_error = e.what();
+    }
+    parsed.close();
+  });
+
+  // Output stage. Results that are not streamed are collected in qobj order.
+  BoundedQueue<std::pair<uint_t, json_t>> results(depth_);
+  json_t result_list = json_t::array();
+  std::thread writer([&]() {
+    LineBuffer buffer(out, out_mutex);
+    std::ostream lines(&buffer);
+    std::pair<uint_t, json_t> res;
+    while (results.pop(res)) {
+      if (sim.stream_output) {
+        json_t line;
+        line["index"] = res.first;
+        line["result"] = std::move(res.second);
+        lines << line.dump() << std::endl;
+      } else
+        result_list.push_back(std::move(res.second));
+    }
+  });
+
+  // Simulation stage. Partial counts are written as lines between those of
+  // the output stage.
+  LineBuffer buffer(out, out_mutex);
+  std::ostream lines(&buffer);
+  bool qobj_success = true;
+  bool completed = false;
+  Job job;
+  try {
+    while (parsed.pop(job)) {
+      json_t res =
+          sim.execute_circuit(job.circ, job.index, job.result_key,
+                              sim.stream_output ? &lines : nullptr);
+      qobj_success &= res["success"].get<bool>();
+      results.push(std::make_pair(job.index, std::move(res)));
+    }
+    output["status"] = std::string("COMPLETED");
+    output["success"] = qobj_success;
+    completed = true;
+  } catch (std::exception &e) {
+    output["success"] = false;
+    output["status"] = std::string("ERROR: ") + e.what();
+  }
+  parsed.close();
+  parser.join();
+  results.close();
+  writer.join();
+  if (sim.stream_output == false)
+    output["result"] = std::move(result_list);
+
+  if (parse_error.empty() == false) {
+    output["success"] = false;
+    output["status"] = "ERROR: unable to parse qobj, " + parse_error;
+  } else if (completed)
+    output["time_taken"] =
+        std::chrono::duration<double>(myclock_t::now() - start).count();
+  out << output.dump(sim.stream_output ? -1 : indent) << std::endl;
+}
+
+void Pipeline::execute_all(Simulator &sim, const source_t &next,
+                           std::ostream &out, int indent) const {
+  try {
+    Circuit circ;
+    std::string key;
+    while (next(circ, key)) {
+      sim.circuits.push_back(std::move(circ));
+      if (sim.result_cache)
+        sim.result_keys.push_back(key);
+    }
+  } catch (std::exception &e) {
+    sim.load_error = e.what();
+  }
+  if (sim.stream_output)
+    sim.execute(out);
+  else
+    out << sim.execute().dump(indent) << std::endl;
+}
+
+int Pipeline::LineBuffer::sync() {
+  const std::string line = str();
+  if (line.empty())
+    return 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  out_ << line;
+  out_.flush();
+  str("");
+  return out_.good() ? 0 : -1;
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    qiskit_simulator.h
+ * @brief   C API of the libqiskit_simulator shared library
+ *
+ * A circuit is built from a flat array of operations, run with a config
+ * struct, and its counts and final state are copied into buffers provided
+ * by the caller. Functions that fail return NULL or 0, and
+ * qiskit_last_error() returns the message of the last failure in the
+ * calling thread. Every handle returned by the library must be freed with
+ * the matching free function.
+ */
+
+#ifndef _qiskit_simulator_h_
+#define _qiskit_simulator_h_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QISKIT_SIMULATOR_API_VERSION 1
+
+/* Opaque handles */
+typedef struct qiskit_circuit qiskit_circuit;
+typedef struct qiskit_result qiskit_result;
+
+/* A circuit operation. Parameters are in the order of the qobj format. An
+   operation is conditional if cond_mask is nonzero, and is then applied only
+   if the clbits set in cond_mask, read from the lowest, hold the bits of
+   cond_val, as for the "mask" and "val" of a qobj conditional. */
+typedef struct qiskit_operation {
+  const char *name;        /* gate name, eg "u3", "cx" or "measure" */
+  const uint64_t *qubits;  /* qubit indices */
+  uint64_t num_qubits;
+  const uint64_t *clbits;  /* clbit indices, eg the measurement targets */
+  uint64_t num_clbits;
+  const double *params;    /* gate parameters */
+  uint64_t num_params;
+  uint64_t cond_mask;      /* bit j set to condition on clbit j, or 0 */
+  uint64_t cond_val;       /* required value of the masked clbits */
+} qiskit_operation;
+
+/* Run configuration. Initialize with qiskit_config_init. */
+typedef struct qiskit_config {
+  const char *simulator;   /* "qubit", "ideal" or "clifford" */
+  uint64_t shots;          /* number of shots */
+  int64_t seed;            /* RNG seed, or negative for a random seed */
+  uint64_t max_threads;    /* maximum number of threads, or 0 for all cores */
+  int quantum_state;       /* nonzero to return the final state vector */
+  const char *options;     /* JSON object of further qobj config options,
+                              eg noise parameters, or NULL */
+} qiskit_config;
+
+/* Returns QISKIT_SIMULATOR_API_VERSION of the library */
+int qiskit_api_version(void);
+
+/* Sets the default config: the qubit simulator, 1 shot and a random seed */
+void qiskit_config_init(qiskit_config *config);
+
+/* Builds a circuit with a single quantum and a single classical register.
+   The operations are copied. Returns NULL on failure. */
+qiskit_circuit *qiskit_circuit_create(uint64_t num_qubits,
+                                      uint64_t num_clbits,
+                                      const qiskit_operation *ops,
+                                      uint64_t num_ops);
+void qiskit_circuit_free(qiskit_circuit *circuit);
+
+/* Runs a circuit. A result is returned for failed simulations too, and
+   qiskit_result_success reports whether it succeeded. Returns NULL only if
+   the arguments are invalid. */
+qiskit_result *qiskit_run(const qiskit_circuit *circuit,
+                          const qiskit_config *config);
+void qiskit_result_free(qiskit_result *result);
+
+/* Returns nonzero if the simulation succeeded */
+int qiskit_result_success(const qiskit_result *result);
+
+/* Returns the status message of the result */
+const char *qiskit_result_status(const qiskit_result *result);
+
+/* Returns the number of distinct measurement outcomes */
+uint64_t qiskit_result_num_outcomes(const qiskit_result *result);
+
+/* Copies up to size outcomes and their counts, and returns the number
+   copied. Bit j of an outcome is the value of clbit j. Circuits with more
+   than 64 clbits must be read with qiskit_result_json. */
+uint64_t qiskit_result_counts(const qiskit_result *result, uint64_t *outcomes,
+                              uint64_t *counts, uint64_t size);
+
+/* Returns the number of amplitudes of the final state, or 0 if it was not
+   requested */
+uint64_t qiskit_result_state_size(const qiskit_result *result);
+
+/* Copies up to size amplitudes of the final state as interleaved real and
+   imaginary parts, so amplitudes must hold 2 * size doubles, and returns the
+   number copied */
+uint64_t qiskit_result_state(const qiskit_result *result, double *amplitudes,
+                             uint64_t size);
+
+/* Returns the full result of the circuit as JSON text in the format of the
+   qiskit_simulator executable. The string is owned by the result. */
+const char *qiskit_result_json(qiskit_result *result);
+
+/* Returns the message of the last failure in the calling thread */
+const char *qiskit_last_error(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
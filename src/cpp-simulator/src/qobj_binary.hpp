@@ -0,0 +1,312 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    qobj_binary.hpp
+ * @brief   Memory mapped loading of qobjs in a compact binary format
+ */
+
+#ifndef _QobjBinary_hpp_
+#define _QobjBinary_hpp_
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simulator.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * BinaryQobj class
+  *
+  * A binary qobj stores the operations of its circuits as fixed width
+  * records and its large state vectors as raw arrays, next to a small JSON
+  * header holding everything else. The file is memory mapped and circuits
+  * are constructed from the records without parsing any text.
+  *
+  * Layout (little-endian):
+  *   char[8]  magic "QOBJBIN\0"
+  *   uint32   format version (1)
+  *   uint32   reserved (0)
+  *   uint64   size of the JSON header in bytes
+  *   char[]   JSON header, zero padded to a multiple of 8 bytes
+  *   data     records and arrays, at offsets relative to the start of data
+  *
+  * The JSON header is a qobj with two differences:
+  * - It has a "names" list of the operation names used by the records, and
+  *   the "operations" of each compiled circuit are a reference
+  *   {"offset": offset, "count": number} to an array of Record.
+  * - A config "initial_state" or "target_states" may be a reference
+  *   {"offset": offset, "dtype": "complex128", "shape": [dims...]} to a raw
+  *   array of complex numbers.
+  *
+  * Symbolic parameters and conditionals on more than 64 clbits are not
+  * supported by the format.
+  *
+  ******************************************************************************/
+
+class BinaryQobj {
+public:
+  // Operation record
+  struct Record {
+    uint32_t name;       // index into the "names" list of the header
+    uint32_t flags;      // bit 0 is set if the operation is conditional
+    uint32_t num_qubits; // number of uint64 qubits at offset qubits
+    uint32_t num_clbits; // number of uint64 clbits at offset clbits
+    uint32_t num_params; // number of float64 params at offset params
+    uint32_t reserved;
+    uint64_t qubits;
+    uint64_t clbits;
+    uint64_t params;
+    uint64_t cond_mask; // the "mask" of a JSON conditional
+    uint64_t cond_val;  // the "val" of a JSON conditional
+  };
+
+  /**
+   * Maps a binary qobj file.
+   * @param file: the file name.
+   */
+  explicit BinaryQobj(const std::string &file);
+  ~BinaryQobj();
+  BinaryQobj(const BinaryQobj &) = delete;
+  BinaryQobj &operator=(const BinaryQobj &) = delete;
+
+  // Returns true if a file starts with the magic of a binary qobj
+  static bool is_binary(const std::string &file);
+
+  /**
+   * Returns the JSON header of the qobj, whose circuits refer to their
+   * operations in the file.
+   */
+  const json_t &header() const { return header_; };
+
+  /**
+   * Constructs the next circuit of the qobj.
+   * @param sim: the simulator loaded from the qobj header.
+   * @param circ: set to the circuit.
+   * @param result_key: cleared, as binary circuits are not result cached.
+   * @returns: false if there are no more circuits.
+   */
+  bool next_circuit(const Simulator &sim, Circuit &circ,
+                    std::string &result_key);
+
+private:
+  static constexpr char magic_[8] = {'Q', 'O', 'B', 'J', 'B', 'I', 'N', '\0'};
+  static constexpr uint32_t version_ = 1;
+
+  void *map_ = MAP_FAILED;
+  size_t size_ = 0;
+  const char *data_ = nullptr; // start of the data section
+  size_t data_size_ = 0;
+
+  json_t header_;
+  std::vector<std::string> names_;
+  uint_t next_ = 0;
+
+  // Returns the array of count values of type T at an offset of the data
+  template <typename T> const T *array(uint_t offset, uint_t count) const;
+
+  // Returns the state vectors of a config state vector reference
+  std::vector<cvector_t> load_states(const json_t &ref, uint_t rank) const;
+};
+
+/*******************************************************************************
+ *
+ * BinaryQobj methods
+ *
+ ******************************************************************************/
+
+constexpr char BinaryQobj::magic_[8];
+constexpr uint32_t BinaryQobj::version_;
+
+bool BinaryQobj::is_binary(const std::string &file) {
+  std::ifstream ifile(file, std::ios::binary);
+  char magic[sizeof(magic_)];
+  return ifile.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, magic_, sizeof(magic)) == 0;
+}
+
+BinaryQobj::BinaryQobj(const std::string &file) {
+  const uint16_t probe = 1;
+  if (*reinterpret_cast<const uint8_t *>(&probe) != 1)
+    throw std::runtime_error("binary qobjs require a little-endian host");
+
+  const int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error(std::string("no such file or directory"));
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    size_ = static_cast<size_t>(st.st_size);
+    map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  const std::string err = std::strerror(errno);
+  close(fd);
+  if (size_ == 0)
+    throw std::runtime_error(std::string("invalid binary qobj file."));
+  if (map_ == MAP_FAILED)
+    throw std::runtime_error("unable to map binary qobj \"" + file +
+                             "\": " + err);
+
+  // Check the preamble and parse the header
+  const char *base = static_cast<const char *>(map_);
+  const size_t preamble = sizeof(magic_) + 2 * sizeof(uint32_t) +
+                          sizeof(uint64_t);
+  uint32_t version = 0;
+  uint64_t header_size = 0;
+  if (size_ >= preamble) {
+    std::memcpy(&version, base + sizeof(magic_), sizeof(version));
+    std::memcpy(&header_size, base + sizeof(magic_) + 2 * sizeof(uint32_t),
+                sizeof(header_size));
+  }
+  if (size_ < preamble || std::memcmp(base, magic_, sizeof(magic_)) != 0 ||
+      header_size > size_ - preamble) {
+    munmap(map_, size_);
+    throw std::runtime_error(std::string("invalid binary qobj file."));
+  }
+  if (version != version_) {
+    munmap(map_, size_);
+    throw std::runtime_error("unsupported binary qobj version " +
+                             std::to_string(version));
+  }
+  const size_t data_start =
+      std::min<size_t>(size_, preamble + ((header_size + 7) & ~7ULL));
+  data_ = base + data_start;
+  data_size_ = size_ - data_start;
+  try {
+    header_ = json_t::parse(std::string(base + preamble, header_size));
+    JSON::get_value(names_, "names", header_);
+  } catch (...) {
+    munmap(map_, size_);
+    throw;
+  }
+}
+
+BinaryQobj::~BinaryQobj() {
+  if (map_ != MAP_FAILED)
+    munmap(map_, size_);
+}
+
+template <typename T>
+const T *BinaryQobj::array(uint_t offset, uint_t count) const {
+  if (offset % alignof(T) != 0 || offset > data_size_ ||
+      count > (data_size_ - offset) / sizeof(T))
+    throw std::runtime_error("invalid binary qobj array at offset " +
+                             std::to_string(offset));
+  return reinterpret_cast<const T *>(data_ + offset);
+}
+
+std::vector<cvector_t> BinaryQobj::load_states(const json_t &ref,
+                                               uint_t rank) const {
+  uint_t offset = 0;
+  std::string dtype;
+  std::vector<uint_t> shape;
+  if (!(ref.is_object() && JSON::get_value(offset, "offset", ref) &&
+        JSON::get_value(dtype, "dtype", ref) &&
+        JSON::get_value(shape, "shape", ref) && shape.size() == rank &&
+        dtype == NPY::dtype<complex_t>::name()))
+    throw std::runtime_error(std::string("invalid binary qobj state vector"));
+
+  const uint_t rows = (rank == 1) ? 1 : shape[0];
+  const uint_t cols = shape.back();
+  const complex_t *vals = array<complex_t>(offset, rows * cols);
+  std::vector<cvector_t> states;
+  for (uint_t r = 0; r < rows; r++)
+    states.emplace_back(vals + r * cols, vals + (r + 1) * cols);
+  return states;
+}
+
+bool BinaryQobj::next_circuit(const Simulator &sim, Circuit &circ,
+                              std::string &result_key) {
+  const json_t &circs = header_["circuits"];
+  if (next_ == circs.size())
+    return false;
+  const json_t &js = circs[next_++];
+  result_key.clear();
+
+  circ = Circuit();
+  circ.parse_header(js["compiled_circuit"]["header"]);
+  const json_t &ops = js["compiled_circuit"]["operations"];
+  uint_t offset = 0, count = 0;
+  if (!(ops.is_object() && JSON::get_value(offset, "offset", ops) &&
+        JSON::get_value(count, "count", ops)))
+    throw std::runtime_error(std::string("invalid qobj file."));
+
+  const Record *records = array<Record>(offset, count);
+  circ.operations.reserve(count);
+  for (uint_t j = 0; j < count; j++) {
+    const Record &rec = records[j];
+    if (rec.name >= names_.size())
+      throw std::runtime_error("invalid operation name index " +
+                               std::to_string(rec.name));
+    operation op;
+    const uint64_t *qubits = array<uint64_t>(rec.qubits, rec.num_qubits);
+    op.qubits.assign(qubits, qubits + rec.num_qubits);
+    const uint64_t *clbits = array<uint64_t>(rec.clbits, rec.num_clbits);
+    op.clbits.assign(clbits, clbits + rec.num_clbits);
+    const double *params = array<double>(rec.params, rec.num_params);
+    op.params.assign(params, params + rec.num_params);
+
+    // Conditionals are checked by the same code as those of JSON qobjs
+    json_t cond;
+    if (rec.flags & 1) {
+      std::stringstream mask, val;
+      mask << "0x" << std::hex << rec.cond_mask;
+      val << "0x" << std::hex << rec.cond_val;
+      cond["type"] = std::string("equals");
+      cond["mask"] = mask.str();
+      cond["val"] = val.str();
+    }
+    circ.add_operation(std::move(op), names_[rec.name], sim.gateset, cond);
+  }
+
+  JSON::get_value(circ.name, "name", js);
+  circ.set_config(JSON::check_key("config", js) ? js["config"] : json_t(),
+                  sim.config, sim.gateset);
+
+  // State vectors are moved from the config to the circuit
+  if (circ.config.count("initial_state") &&
+      circ.config["initial_state"].is_object()) {
+    auto states = load_states(circ.config["initial_state"], 1);
+    circ.initial_state =
+        std::make_shared<const cvector_t>(std::move(states.front()));
+    circ.config.erase("initial_state");
+  }
+  if (circ.config.count("target_states") &&
+      circ.config["target_states"].is_object()) {
+    circ.target_states = std::make_shared<const std::vector<cvector_t>>(
+        load_states(circ.config["target_states"], 2));
+    circ.config.erase("target_states");
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+//------------------------------------------------------------------------------
+#endif
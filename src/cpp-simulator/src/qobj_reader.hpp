@@ -0,0 +1,566 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    qobj_reader.hpp
+ * @brief   Streaming reader of qobj JSON that constructs circuits directly
+ */
+
+#ifndef _QobjReader_hpp_
+#define _QobjReader_hpp_
+
+#include <cstdlib>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "simulator.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * QobjReader class
+  *
+  * Reads a qobj from a stream one circuit at a time without building a JSON
+  * tree of the whole qobj. The operations of each circuit are read field by
+  * field into operation structs and appended to the circuit as they are
+  * read, with the same checks as Circuit::parse. Only small values, such as
+  * the configs, circuit headers and conditionals, are read as JSON trees.
+  *
+  * Circuits are streamed if the qobj "id" and "config" precede its
+  * "circuits", which is the order written by QISKit. Otherwise the circuits
+  * are read as a JSON tree with the rest of the qobj. Circuits that may be
+  * stored in a circuit or result cache are also read as JSON trees, as their
+  * JSON text is the cache key.
+  *
+  ******************************************************************************/
+
+class QobjReader {
+public:
+  explicit QobjReader(std::istream &in) : in_(in), buffer_(1 << 16){};
+
+  /**
+   * Reads the qobj up to its circuits.
+   * @returns: the qobj, whose "circuits" list is empty if the circuits are
+   *           streamed.
+   */
+  json_t read_header();
+
+  /**
+   * Returns true if the circuits are read by next_circuit, and false if they
+   * were read with the qobj by read_header.
+   */
+  bool streaming() const { return streaming_; };
+
+  /**
+   * Reads the next circuit of a streamed qobj.
+   * @param sim: the simulator loaded from the qobj header.
+   * @param circ: set to the circuit.
+   * @param result_key: set to the result cache key of the circuit.
+   * @returns: false if there are no more circuits.
+   */
+  bool next_circuit(const Simulator &sim, Circuit &circ,
+                    std::string &result_key);
+
+private:
+  std::istream &in_;
+  std::vector<char> buffer_;
+  size_t pos_ = 0;
+  size_t end_ = 0;
+
+  bool streaming_ = false;
+  bool first_ = true; // the next circuit is the first in the list
+  bool done_ = false; // all circuits were read
+
+  // Operations read before the circuit header, which are appended once the
+  // number of qubits and clbits is known
+  struct PendingOp {
+    operation op;
+    std::string label;
+    json_t cond;
+  };
+
+  // Character input
+  int peek();
+  int get();
+  void skip_ws();
+  void expect(char c);
+  [[noreturn]] void unexpected();
+
+  // Consumes the ',' after a member or element and returns true, or consumes
+  // the closing bracket of the object or array and returns false
+  bool next_item(char close);
+
+  // Values
+  std::string read_string();
+  std::string read_number_token();
+  json_t read_value();
+  double read_double();
+  uint_t read_uint();
+
+  // Calls member(key) for each member of an object, which must read the
+  // member value, and element() for each element of an array
+  template <typename F> void read_object(F member);
+  template <typename F> void read_array(F element);
+
+  // Qobj circuits
+  void read_circuit(const Simulator &sim, Circuit &circ);
+  void read_operation(Circuit &circ, const gateset_t &gs, bool header,
+                      std::vector<PendingOp> &pending);
+  static void check_circuit(const json_t &circ);
+};
+
+/*******************************************************************************
+ *
+ * QobjReader methods
+ *
+ ******************************************************************************/
+
+int QobjReader::peek() {
+  if (pos_ == end_) {
+    in_.read(buffer_.data(), buffer_.size());
+    end_ = static_cast<size_t>(in_.gcount());
+    pos_ = 0;
+    if (end_ == 0)
+      return EOF;
+  }
+  return static_cast<unsigned char>(buffer_[pos_]);
+}
+
+int QobjReader::get() {
+  const int c = peek();
+  if (c != EOF)
+    pos_++;
+  return c;
+}
+
+void QobjReader::skip_ws() {
+  for (int c = peek(); c == ' ' || c == '\t' || c == '\n' || c == '\r';
+       c = peek())
+    pos_++;
+}
+
+void QobjReader::expect(char c) {
+  skip_ws();
+  if (peek() != c)
+    unexpected();
+  pos_++;
+}
+
+bool QobjReader::next_item(char close) {
+  skip_ws();
+  const int c = peek();
+  if (c != ',' && c != close)
+    unexpected();
+  pos_++;
+  return c == ',';
+}
+
+void QobjReader::unexpected() {
+  const int c = peek();
+  if (c == EOF)
+    throw std::invalid_argument("parse error - unexpected end of input");
+  throw std::invalid_argument(std::string("parse error - unexpected '") +
+                              static_cast<char>(c) + "'");
+}
+
+//------------------------------------------------------------------------------
+std::string QobjReader::read_string() {
+  expect('"');
+  std::string str;
+  while (true) {
+    int c = get();
+    if (c == '"')
+      return str;
+    if (c == EOF || c < 0x20)
+      throw std::invalid_argument("parse error - invalid string");
+    if (c != '\\') {
+      str.push_back(static_cast<char>(c));
+      continue;
+    }
+    c = get();
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+      str.push_back(static_cast<char>(c));
+      break;
+    case 'b':
+      str.push_back('\b');
+      break;
+    case 'f':
+      str.push_back('\f');
+      break;
+    case 'n':
+      str.push_back('\n');
+      break;
+    case 'r':
+      str.push_back('\r');
+      break;
+    case 't':
+      str.push_back('\t');
+      break;
+    case 'u': {
+      // Code points are encoded as UTF-8, combining surrogate pairs
+      auto hex4 = [this]() {
+        unsigned cp = 0;
+        for (int k = 0; k < 4; k++) {
+          const int h = get();
+          cp <<= 4;
+          if (h >= '0' && h <= '9')
+            cp |= static_cast<unsigned>(h - '0');
+          else if (h >= 'a' && h <= 'f')
+            cp |= static_cast<unsigned>(h - 'a' + 10);
+          else if (h >= 'A' && h <= 'F')
+            cp |= static_cast<unsigned>(h - 'A' + 10);
+          else
+            throw std::invalid_argument("parse error - invalid escape");
+        }
+        return cp;
+      };
+      unsigned cp = hex4();
+      if (cp >= 0xd800 && cp < 0xdc00) {
+        if (get() != '\\' || get() != 'u')
+          throw std::invalid_argument("parse error - invalid surrogate pair");
+        const unsigned low = hex4();
+        if (low < 0xdc00 || low >= 0xe000)
+          throw std::invalid_argument("parse error - invalid surrogate pair");
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+      }
+      if (cp < 0x80)
+        str.push_back(static_cast<char>(cp));
+      else if (cp < 0x800) {
+        str.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+      } else if (cp < 0x10000) {
+        str.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+      } else {
+        str.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+      }
+      break;
+    }
+    default:
+      throw std::invalid_argument("parse error - invalid escape");
+    }
+  }
+}
+
+std::string QobjReader::read_number_token() {
+  skip_ws();
+  std::string token;
+  for (int c = peek(); (c >= '0' && c <= '9') || c == '-' || c == '+' ||
+                       c == '.' || c == 'e' || c == 'E';
+       c = peek()) {
+    token.push_back(static_cast<char>(c));
+    pos_++;
+  }
+  if (token.empty())
+    unexpected();
+  return token;
+}
+
+json_t QobjReader::read_value() {
+  skip_ws();
+  const int c = peek();
+  if (c == '{') {
+    json_t obj = json_t::object();
+    read_object([&](const std::string &key) { obj[key] = read_value(); });
+    return obj;
+  }
+  if (c == '[') {
+    json_t arr = json_t::array();
+    read_array([&]() { arr.push_back(read_value()); });
+    return arr;
+  }
+  if (c == '"')
+    return read_string();
+  if (c == 't' || c == 'f' || c == 'n') {
+    std::string word;
+    while (peek() >= 'a' && peek() <= 'z')
+      word.push_back(static_cast<char>(get()));
+    if (word == "true")
+      return true;
+    if (word == "false")
+      return false;
+    if (word == "null")
+      return json_t();
+    throw std::invalid_argument("parse error - unexpected '" + word + "'");
+  }
+  // Numbers are integers unless they have a fraction or exponent
+  const std::string token = read_number_token();
+  char *last = nullptr;
+  json_t num;
+  if (token.find_first_of(".eE") != std::string::npos)
+    num = std::strtod(token.c_str(), &last);
+  else if (token[0] == '-')
+    num = static_cast<int_t>(std::strtoll(token.c_str(), &last, 10));
+  else
+    num = static_cast<uint_t>(std::strtoull(token.c_str(), &last, 10));
+  if (last != token.c_str() + token.size())
+    throw std::invalid_argument("parse error - invalid number '" + token +
+                                "'");
+  return num;
+}
+
+double QobjReader::read_double() {
+  skip_ws();
+  const int c = peek();
+  if (c != '-' && (c < '0' || c > '9'))
+    return read_value().get<double>(); // same conversion errors as a tree
+  const std::string token = read_number_token();
+  char *last = nullptr;
+  const double val = std::strtod(token.c_str(), &last);
+  if (last != token.c_str() + token.size())
+    throw std::invalid_argument("parse error - invalid number '" + token +
+                                "'");
+  return val;
+}
+
+uint_t QobjReader::read_uint() {
+  skip_ws();
+  const int c = peek();
+  if (c < '0' || c > '9')
+    return read_value().get<uint_t>();
+  const std::string token = read_number_token();
+  char *last = nullptr;
+  uint_t val;
+  if (token.find_first_not_of("0123456789") != std::string::npos)
+    val = static_cast<uint_t>(std::strtod(token.c_str(), &last));
+  else
+    val = std::strtoull(token.c_str(), &last, 10);
+  if (last != token.c_str() + token.size())
+    throw std::invalid_argument("parse error - invalid number '" + token +
+                                "'");
+  return val;
+}
+
+template <typename F> void QobjReader::read_object(F member) {
+  expect('{');
+  skip_ws();
+  if (peek() == '}') {
+    pos_++;
+    return;
+  }
+  while (true) {
+    const std::string key = read_string();
+    expect(':');
+    member(key);
+    if (next_item('}') == false)
+      return;
+  }
+}
+
+template <typename F> void QobjReader::read_array(F element) {
+  expect('[');
+  skip_ws();
+  if (peek() == ']') {
+    pos_++;
+    return;
+  }
+  while (true) {
+    element();
+    if (next_item(']') == false)
+      return;
+  }
+}
+
+//------------------------------------------------------------------------------
+json_t QobjReader::read_header() {
+  json_t qobj = json_t::object();
+  expect('{');
+  skip_ws();
+  if (peek() == '}') {
+    pos_++;
+    return qobj;
+  }
+  while (true) {
+    const std::string key = read_string();
+    expect(':');
+    if (key == "circuits" && JSON::check_key("id", qobj) &&
+        JSON::check_key("config", qobj)) {
+      // The remaining members are read after the circuits
+      expect('[');
+      streaming_ = true;
+      qobj["circuits"] = json_t::array();
+      return qobj;
+    }
+    qobj[key] = read_value();
+    if (next_item('}') == false)
+      return qobj;
+  }
+}
+
+bool QobjReader::next_circuit(const Simulator &sim, Circuit &circ,
+                              std::string &result_key) {
+  if (streaming_ == false || done_)
+    return false;
+  skip_ws();
+  if (peek() == ']') {
+    // Skip the members of the qobj that follow the circuits
+    pos_++;
+    done_ = true;
+    while (next_item('}')) {
+      read_string();
+      expect(':');
+      read_value();
+    }
+    return false;
+  }
+  if (first_ == false)
+    expect(',');
+  first_ = false;
+
+  result_key.clear();
+  if (sim.circuit_cache || sim.result_cache) {
+    const json_t js = read_value();
+    check_circuit(js);
+    circ = sim.load_circuit(js, result_key);
+  } else {
+    circ = Circuit();
+    read_circuit(sim, circ);
+  }
+  return true;
+}
+
+void QobjReader::check_circuit(const json_t &circ) {
+  const std::vector<std::string> compiled_keys{"header", "operations"};
+  const std::vector<std::string> header_keys{
+      "clbit_labels", "number_of_clbits", "number_of_qubits", "qubit_labels"};
+  if (JSON::check_key("compiled_circuit", circ) == false ||
+      JSON::check_keys(compiled_keys, circ["compiled_circuit"]) == false ||
+      JSON::check_keys(header_keys, circ["compiled_circuit"]["header"]) ==
+          false)
+    throw std::runtime_error(std::string("invalid qobj file."));
+}
+
+void QobjReader::read_circuit(const Simulator &sim, Circuit &circ) {
+  const std::vector<std::string> header_keys{
+      "clbit_labels", "number_of_clbits", "number_of_qubits", "qubit_labels"};
+  bool compiled = false;
+  bool header = false;
+  bool operations = false;
+  json_t config;
+  std::vector<PendingOp> pending;
+
+  read_object([&](const std::string &key) {
+    if (key == "compiled_circuit") {
+      compiled = true;
+      read_object([&](const std::string &ckey) {
+        if (ckey == "header") {
+          const json_t js = read_value();
+          if (JSON::check_keys(header_keys, js) == false)
+            throw std::runtime_error(std::string("invalid qobj file."));
+          circ.parse_header(js);
+          header = true;
+          for (auto &p : pending)
+            circ.add_operation(std::move(p.op), p.label, sim.gateset, p.cond);
+          pending.clear();
+        } else if (ckey == "operations") {
+          skip_ws();
+          if (peek() == '[') {
+            operations = true;
+            read_array([&]() {
+              read_operation(circ, sim.gateset, header, pending);
+            });
+          } else
+            operations = (read_value().is_null() == false);
+        } else
+          read_value();
+      });
+    } else if (key == "config")
+      config = read_value();
+    else if (key == "name") {
+      const json_t name = read_value();
+      if (name.is_null() == false)
+        circ.name = name.get<std::string>();
+    } else
+      read_value();
+  });
+
+  if (compiled == false || header == false || operations == false)
+    throw std::runtime_error(std::string("invalid qobj file."));
+  circ.set_config(config, sim.config, sim.gateset);
+}
+
+void QobjReader::read_operation(Circuit &circ, const gateset_t &gs,
+                                bool header, std::vector<PendingOp> &pending) {
+  operation op;
+  std::string label;
+  bool named = false;
+  json_t cond;
+  skip_ws();
+  if (peek() != '{') {
+    read_value();
+    throw std::runtime_error(std::string("invalid operation \'\'."));
+  }
+  read_object([&](const std::string &key) {
+    if (key == "name") {
+      const json_t name = read_value();
+      if (name.is_null() == false) {
+        label = name.get<std::string>();
+        named = true;
+      }
+    } else if (key == "params") {
+      skip_ws();
+      if (peek() != '[') {
+        for (const auto &par : read_value())
+          op.params.push_back(par.get<double>());
+        return;
+      }
+      read_array([&]() {
+        skip_ws();
+        if (peek() == '"') {
+          // symbolic parameters are bound for each circuit of a sweep
+          op.symbols[op.params.size()] = read_string();
+          op.params.push_back(0.);
+        } else
+          op.params.push_back(read_double());
+      });
+    } else if (key == "qubits" || key == "clbits") {
+      creg_t &bits = (key == "qubits") ? op.qubits : op.clbits;
+      skip_ws();
+      if (peek() == '[')
+        read_array([&]() { bits.push_back(read_uint()); });
+      else {
+        const json_t js = read_value();
+        if (js.is_null() == false)
+          bits = js.get<creg_t>();
+      }
+    } else if (key == "conditional")
+      cond = read_value();
+    else
+      read_value();
+  });
+  if (named == false)
+    throw std::runtime_error(std::string("invalid operation \'\'."));
+  if (header)
+    circ.add_operation(std::move(op), label, gs, cond);
+  else
+    pending.push_back({std::move(op), label, std::move(cond)});
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,185 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    scheduler.hpp
+ * @brief   Memory and core admission control for concurrent jobs
+ */
+
+#ifndef _Scheduler_hpp_
+#define _Scheduler_hpp_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "types.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * Scheduler class
+  *
+  * Admits jobs to run concurrently in one process according to their
+  * estimated memory footprint and the free cores. Waiting jobs are admitted
+  * in order of decreasing priority, then earliest deadline, then arrival, and
+  * a job is only admitted when it is first in this order, so large jobs are
+  * not starved by smaller ones behind them.
+  *
+  * A job is admitted when at least one core is free and its shared memory
+  * and footprint for a single shot thread fit in the free memory. A job
+  * larger than the total memory is admitted alone. An admitted job is granted
+  * an equal share of the free cores among the waiting jobs, but at most the
+  * share of the cores of one of the expected number of concurrent jobs, so
+  * cores are left for jobs arriving later. It is granted as many shot
+  * threads as the granted cores and the free memory allow.
+  *
+  ******************************************************************************/
+
+class Scheduler {
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  // Resources granted to an admitted job
+  struct Grant {
+    uint_t threads = 1;      // total threads
+    uint_t shot_threads = 1; // parallel shot threads
+    double memory = 0.;      // reserved memory in bytes
+  };
+
+  /**
+   * Constructs a scheduler for a process.
+   * @param memory: the memory in bytes shared by all jobs.
+   * @param cores: the number of cores shared by all jobs.
+   * @param jobs: the expected number of concurrent jobs.
+   */
+  Scheduler(double memory, uint_t cores, uint_t jobs = 4)
+      : free_memory_(memory), free_cores_(std::max<uint_t>(1, cores)),
+        max_grant_(
+            std::max<uint_t>(1, free_cores_ / std::max<uint_t>(1, jobs))){};
+
+  /**
+   * Blocks until a job is admitted.
+   * @param footprint: memory in bytes needed by one shot thread of the job.
+   * @param shared: memory in bytes needed once by the job.
+   * @param priority: jobs with higher priority are admitted first.
+   * @param deadline: the latest time to admit the job, or
+   *                  clock_t::time_point::max() for none.
+   * @param grant: set to the resources granted to the job.
+   * @returns: false if the deadline passed before the job was admitted.
+   */
+  bool acquire(double footprint, double shared, int_t priority,
+               clock_t::time_point deadline, Grant &grant);
+
+  /**
+   * Returns the resources of a finished job.
+   */
+  void release(const Grant &grant);
+
+private:
+  struct Job {
+    uint_t id;
+    double footprint;
+    double shared;
+    int_t priority;
+    clock_t::time_point deadline;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  double free_memory_;
+  uint_t free_cores_;
+  uint_t max_grant_; // most cores granted to one job
+  uint_t running_ = 0;
+  uint_t next_id_ = 0;
+  std::vector<Job> waiting_;
+
+  // Returns the waiting job to admit next
+  std::vector<Job>::iterator next();
+};
+
+/*******************************************************************************
+ *
+ * Scheduler methods
+ *
+ ******************************************************************************/
+
+std::vector<Scheduler::Job>::iterator Scheduler::next() {
+  return std::min_element(
+      waiting_.begin(), waiting_.end(), [](const Job &a, const Job &b) {
+        if (a.priority != b.priority)
+          return a.priority > b.priority;
+        if (a.deadline != b.deadline)
+          return a.deadline < b.deadline;
+        return a.id < b.id;
+      });
+}
+
+bool Scheduler::acquire(double footprint, double shared, int_t priority,
+                        clock_t::time_point deadline, Grant &grant) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint_t id = next_id_++;
+  waiting_.push_back(Job{id, footprint, shared, priority, deadline});
+  while (true) {
+    auto job = next();
+    if (job->id == id && free_cores_ > 0 &&
+        (shared + footprint <= free_memory_ || running_ == 0)) {
+      grant.threads = std::max<uint_t>(1, free_cores_ / waiting_.size());
+      grant.threads = std::min(grant.threads, max_grant_);
+      grant.shot_threads = 1;
+      if (footprint > 0. && shared + footprint <= free_memory_)
+        grant.shot_threads = std::min<uint_t>(
+            grant.threads, static_cast<uint_t>(
+                               std::floor((free_memory_ - shared) / footprint)));
+      grant.memory =
+          std::min(free_memory_, shared + grant.shot_threads * footprint);
+      free_memory_ -= grant.memory;
+      free_cores_ -= grant.threads;
+      running_++;
+      waiting_.erase(job);
+      // The next waiting job may also fit
+      cv_.notify_all();
+      return true;
+    }
+    if (deadline == clock_t::time_point::max())
+      cv_.wait(lock);
+    else if (cv_.wait_until(lock, deadline) == std::cv_status::timeout &&
+             clock_t::now() >= deadline) {
+      auto it = std::find_if(waiting_.begin(), waiting_.end(),
+                             [id](const Job &j) { return j.id == id; });
+      waiting_.erase(it);
+      cv_.notify_all();
+      return false;
+    }
+  }
+}
+
+void Scheduler::release(const Grant &grant) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_memory_ += grant.memory;
+  free_cores_ += grant.threads;
+  running_--;
+  cv_.notify_all();
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,366 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    server.hpp
+ * @brief   Persistent simulator server on a Unix domain socket
+ */
+
+#ifndef _Server_hpp_
+#define _Server_hpp_
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "scheduler.hpp"
+#include "simulator.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * Server class
+  *
+  * Listens on a Unix domain socket and executes each qobj it receives, so
+  * that the OpenMP thread pool, the parsed circuits and the checkpoint cache
+  * stay warm between jobs. Each message in either direction is an 8 byte
+  * little-endian length followed by that many bytes of JSON. A client may
+  * send any number of requests on a connection, and each is answered with
+  * the qobj result. The request {"command": "shutdown"} stops the server.
+  * A request longer than the size limit is answered with an error and its
+  * connection is closed.
+  *
+  * Connections are served by separate threads. Their qobjs are run
+  * concurrently as admitted by a scheduler, which divides the physical memory
+  * and the cores of the machine between them. The qobj config options
+  * "priority" (higher first, default 0) and "deadline" (seconds to wait for
+  * admission) control the order of waiting qobjs.
+  *
+  ******************************************************************************/
+
+class Server {
+public:
+  /**
+   * Constructs a server for a socket path.
+   * @param path: the file system path of the socket.
+   * @param circuits: the number of parsed circuits kept between requests.
+   * @param jobs: the number of concurrent qobjs the cores are divided
+   *              between.
+   * @param max_request_mb: the size limit of a request in MB.
+   */
+  explicit Server(std::string path, uint_t circuits = 1024, uint_t jobs = 4,
+                  uint_t max_request_mb = 1024)
+      : path_(std::move(path)), max_request_(max_request_mb << 20),
+        scheduler_(static_cast<double>(sysconf(_SC_PHYS_PAGES)) *
+                       static_cast<double>(sysconf(_SC_PAGE_SIZE)),
+                   std::thread::hardware_concurrency(), jobs),
+        circuit_cache_(std::make_shared<LRUCache<Circuit>>(circuits)){};
+
+  /**
+   * Binds the socket and serves connections until a shutdown request is
+   * received. The socket file is removed when the server stops.
+   */
+  void run();
+
+  /**
+   * Executes a single request.
+   * @param request: the JSON text of a qobj or a command.
+   * @returns: the JSON text of the result.
+   */
+  std::string execute(const std::string &request);
+
+private:
+  std::string path_;
+  uint_t max_request_; // size limit of a request in bytes
+  int fd_ = -1;
+  std::atomic<bool> stop_{false};
+
+  // Admits qobjs for execution
+  Scheduler scheduler_;
+
+  // Caches shared by all requests. The mutex guards the checkpoint cache
+  // pointer, which is set by the first qobj that requests a cache.
+  std::mutex cache_mutex_;
+  std::shared_ptr<LRUCache<Circuit>> circuit_cache_;
+  std::shared_ptr<BaseEngine<cvector_t>::checkpoint_cache_t> checkpoint_cache_;
+
+  // Threads serving connections and their sockets, which are set to -1 when
+  // the connection is closed
+  std::mutex conn_mutex_;
+  std::vector<std::pair<std::thread, int>> connections_;
+
+  // Serves the requests of a connection until the client closes it or sends
+  // an invalid message
+  void serve(int conn);
+
+  // Reads and writes a length prefixed message. Return false if the
+  // connection was closed. Reading throws if the message is longer than the
+  // request size limit.
+  bool read_message(int conn, std::string &msg) const;
+  static bool write_message(int conn, const std::string &msg);
+  static bool read_all(int conn, char *data, size_t len);
+  static bool write_all(int conn, const char *data, size_t len);
+};
+
+/*******************************************************************************
+ *
+ * Server methods
+ *
+ ******************************************************************************/
+
+void Server::run() {
+  // Writes to a closed connection must not terminate the server
+  std::signal(SIGPIPE, SIG_IGN);
+
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path_.size() >= sizeof(addr.sun_path))
+    throw std::runtime_error("socket path \"" + path_ + "\" is too long");
+  std::strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+
+  fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0)
+    throw std::runtime_error(std::string("unable to create socket: ") +
+                             std::strerror(errno));
+  unlink(path_.c_str());
+  if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(fd_, 16) < 0) {
+    const std::string err = std::strerror(errno);
+    close(fd_);
+    throw std::runtime_error("unable to listen on socket \"" + path_ +
+                             "\": " + err);
+  }
+
+  while (stop_ == false) {
+    const int conn = accept(fd_, nullptr, nullptr);
+    if (conn < 0) {
+      if (errno == EINTR)
+        continue;
+      break; // the listening socket was shut down
+    }
+    std::lock_guard<std::mutex> lock(conn_mutex_);
+    if (stop_) {
+      close(conn);
+      break;
+    }
+    // Join the threads of closed connections
+    for (auto it = connections_.begin(); it != connections_.end();) {
+      if (it->second < 0) {
+        it->first.join();
+        it = connections_.erase(it);
+      } else
+        ++it;
+    }
+    connections_.emplace_back(std::thread(&Server::serve, this, conn), conn);
+  }
+
+  // Close idle connections and wait for running requests
+  {
+    std::lock_guard<std::mutex> lock(conn_mutex_);
+    for (auto &conn : connections_)
+      if (conn.second >= 0)
+        shutdown(conn.second, SHUT_RDWR);
+  }
+  for (auto &conn : connections_)
+    conn.first.join();
+  close(fd_);
+  unlink(path_.c_str());
+}
+
+void Server::serve(int conn) {
+  // Errors are answered on the connection, which is then closed, so that a
+  // bad client cannot terminate the server
+  try {
+    std::string msg;
+    while (read_message(conn, msg)) {
+      if (write_message(conn, execute(msg)) == false)
+        break;
+      if (stop_) {
+        // Unblock accept in the listening thread
+        shutdown(fd_, SHUT_RDWR);
+        break;
+      }
+    }
+  } catch (std::exception &e) {
+    json_t ret;
+    ret["success"] = false;
+    ret["status"] = std::string("ERROR: ") + e.what();
+    write_message(conn, ret.dump());
+  }
+  std::lock_guard<std::mutex> lock(conn_mutex_);
+  for (auto &c : connections_)
+    if (c.second == conn)
+      c.second = -1;
+  close(conn);
+}
+
+std::string Server::execute(const std::string &request) {
+  json_t ret;
+  json_t qobj;
+  try {
+    qobj = json_t::parse(request);
+  } catch (std::exception &e) {
+    ret["success"] = false;
+    ret["status"] = std::string("ERROR: Invalid input (") + e.what() + ")";
+    return ret.dump();
+  }
+
+  std::string command;
+  if (JSON::get_value(command, "command", qobj)) {
+    if (command == "shutdown") {
+      stop_ = true;
+      ret["success"] = true;
+      ret["status"] = std::string("SHUTDOWN");
+    } else {
+      ret["success"] = false;
+      ret["status"] = "ERROR: unknown command \"" + command + "\"";
+    }
+    return ret.dump();
+  }
+
+  try {
+    Simulator sim;
+    sim.circuit_cache = circuit_cache_;
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex_);
+      sim.checkpoint_cache = checkpoint_cache_;
+    }
+    from_json(qobj, sim);
+    if (sim.checkpoint_cache) {
+      // The first qobj to request a checkpoint cache sets its size
+      std::lock_guard<std::mutex> lock(cache_mutex_);
+      if (!checkpoint_cache_)
+        checkpoint_cache_ = sim.checkpoint_cache;
+    }
+
+    // Wait for admission
+    int_t priority = 0;
+    double deadline = 0.;
+    if (JSON::check_key("config", qobj)) {
+      JSON::get_value(priority, "priority", qobj["config"]);
+      JSON::get_value(deadline, "deadline", qobj["config"]);
+    }
+    auto latest = Scheduler::clock_t::time_point::max();
+    if (deadline > 0.)
+      latest = Scheduler::clock_t::now() +
+               std::chrono::duration_cast<Scheduler::clock_t::duration>(
+                   std::chrono::duration<double>(deadline));
+    Scheduler::Grant grant;
+    if (scheduler_.acquire(sim.memory_footprint(), sim.cache_footprint(),
+                           priority, latest, grant) == false) {
+      ret["id"] = sim.id;
+      ret["success"] = false;
+      ret["status"] = std::string("ERROR: deadline passed before the qobj "
+                                  "was admitted");
+      return ret.dump();
+    }
+    sim.max_threads = grant.threads;
+    if (sim.max_threads_shot == 0 || sim.max_threads_shot > grant.shot_threads)
+      sim.max_threads_shot = grant.shot_threads;
+    if (grant.memory > 0.)
+      sim.max_memory_gb = std::min(sim.max_memory_gb, grant.memory * 1e-9);
+
+    std::string result;
+    try {
+      if (sim.stream_output) {
+        // Streamed lines are returned together as one message
+        std::stringstream out;
+        sim.execute(out);
+        result = out.str();
+      } else
+        result = sim.execute().dump();
+    } catch (...) {
+      scheduler_.release(grant);
+      throw;
+    }
+    scheduler_.release(grant);
+    return result;
+  } catch (std::exception &e) {
+    ret["success"] = false;
+    ret["status"] =
+        std::string("ERROR: Failed to execute qobj (") + e.what() + ")";
+    return ret.dump();
+  }
+}
+
+bool Server::read_message(int conn, std::string &msg) const {
+  unsigned char header[8];
+  if (read_all(conn, reinterpret_cast<char *>(header), 8) == false)
+    return false;
+  uint_t len = 0;
+  for (int j = 7; j >= 0; j--)
+    len = (len << 8) | header[j];
+  if (len > max_request_)
+    throw std::runtime_error("request of " + std::to_string(len) +
+                             " bytes exceeds the limit of " +
+                             std::to_string(max_request_) + " bytes");
+  msg.resize(len);
+  return len == 0 || read_all(conn, &msg[0], len);
+}
+
+bool Server::write_message(int conn, const std::string &msg) {
+  char header[8];
+  uint_t len = msg.size();
+  for (int j = 0; j < 8; j++, len >>= 8)
+    header[j] = static_cast<char>(len & 0xff);
+  return write_all(conn, header, 8) && write_all(conn, msg.data(), msg.size());
+}
+
+bool Server::read_all(int conn, char *data, size_t len) {
+  while (len > 0) {
+    const ssize_t n = read(conn, data, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool Server::write_all(int conn, const char *data, size_t len) {
+  while (len > 0) {
+    const ssize_t n = write(conn, data, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+//------------------------------------------------------------------------------
+#endif
@@ -23,8 +23,13 @@ limitations under the License.
 #ifndef _Simulator_hpp_
 #define _Simulator_hpp_
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <sstream>
 #include <stdexcept>
@@ -38,12 +43,15 @@ limitations under the License.
 #endif
 
 #include "circuit.hpp"
+#include "lru_cache.hpp"
 #include "misc.hpp"
 #include "noise_models.hpp"
+#include "result_cache.hpp"
 #include "types.hpp"
 
 // Engines
 #include "base_engine.hpp"
+#include "gradient_engine.hpp"
 #include "sampleshots_engine.hpp"
 #include "vector_engine.hpp"
 
@@ -54,6 +62,20 @@ limitations under the License.
 
 namespace QISKIT {
 
+/*******************************************************************************
+ *
+ * EngineType struct
+ *
+ * Tag naming the engine and backend a circuit is run with, which is passed
+ * to the visitor of Simulator::dispatch.
+ *
+ ******************************************************************************/
+
+template <class Engine, class Backend> struct EngineType {
+  using engine_t = Engine;
+  using backend_t = Backend;
+};
+
 /***************************************************************************/ /**
    *
    * Simulator class
@@ -67,9 +89,44 @@ public:
   std::vector<Circuit> circuits;   // QISKIT program
 
   // Multithreading Params
-  uint_t max_memory_gb = 16;   // max memory to use
+  double max_memory_gb = 16;   // max memory to use
   uint_t max_threads_shot = 0; // 0 for automatic
   uint_t max_threads_gate = 0; // 0 for automatic
+  uint_t max_threads = 0;      // total threads (0 for all cores)
+
+  // Streaming output
+  bool stream_output = false; // write results as newline delimited JSON
+  uint_t stream_shots = 0;    // shots between partial counts (0 for none)
+
+  // Checkpoint cache of circuit prefix states shared by all circuits run by
+  // this simulator (null if disabled)
+  std::shared_ptr<BaseEngine<cvector_t>::checkpoint_cache_t> checkpoint_cache;
+
+  // Simulate the leading operations shared by several circuits once
+  bool prefix_sharing = false;
+
+  // Cache of parsed circuits shared between qobjs, keyed by a hash of the
+  // circuit JSON, the qobj config and the simulator (null if disabled)
+  std::shared_ptr<LRUCache<Circuit>> circuit_cache;
+
+  // On-disk cache of circuit results (null if disabled), and the content
+  // hash of each circuit that may be cached, which is empty for circuits
+  // without a fixed seed
+  std::shared_ptr<ResultCache> result_cache;
+  std::vector<std::string> result_keys;
+
+  // Qobj level config and simulator gateset used to construct circuits
+  json_t config;
+  gateset_t gateset;
+
+  // If false from_json only loads the qobj level options, and the circuits
+  // are constructed later with load_circuit
+  bool load_circuits = true;
+
+  // Error of the first circuit that could not be loaded. Only the circuits
+  // before it are loaded, and the qobj fails with this error once they have
+  // been run.
+  std::string load_error;
 
   // Constructor
   inline Simulator(){};
@@ -77,9 +134,93 @@ public:
   // Execute all quantum circuits
   json_t execute();
 
-  // Execute a single circuit
+  // Execute all quantum circuits writing each circuit result to an output
+  // stream as a line of JSON as soon as it completes
+  void execute(std::ostream &out);
+
+  // Constructs a circuit of the qobj with the qobj config and gateset,
+  // reusing the circuit cache if it is set. The result cache key of the
+  // circuit is set if it may be cached, and is empty otherwise.
+  Circuit load_circuit(const json_t &js, std::string &result_key) const;
+
+  // Execute a single circuit on the simulator backend it requires, looking
+  // up and storing its result in the result cache if a key is given
+  json_t execute_circuit(Circuit &circ, uint_t index,
+                         const std::string &result_key, std::ostream *out);
+
+  // Chooses the engine and backend a circuit is run with, and returns the
+  // result of calling visit with an EngineType tag naming them
+  template <class Visitor>
+  auto dispatch(const Circuit &circ, Visitor &&visit) const
+      -> decltype(visit(EngineType<VectorEngine, QubitBackend>()));
+
+  // Estimated memory in bytes needed by one shot thread of the circuit with
+  // the largest footprint. This counts the state and its shot branching
+  // snapshot, saved states, and the final state and density matrix outputs.
+  double memory_footprint() const;
+
+  // Estimated memory in bytes of the states kept once for the whole qobj by
+  // the checkpoint cache, or by the snapshots of prefix sharing
+  double cache_footprint() const;
+
+  // Throws if the state of a circuit does not fit in max_memory_gb
+  void check_memory(const Circuit &circ) const;
+
+  // Execute a single circuit. If an output stream is given partial counts are
+  // written to it every stream_shots shots.
+  template <class Engine, class Backend>
+  json_t run_circuit(Circuit &circ, std::ostream *out = nullptr,
+                     uint_t index = 0) const;
+
+  // Attach the checkpoint cache and the binary qobj states of a circuit to an
+  // engine constructed from its config, and name the binary outputs of the
+  // engine by the circuit index
+  template <class Engine>
+  void setup_engine(const Circuit &circ, Engine &engine, uint_t index) const;
+
+  // Execute the shots of a circuit, splitting them over shot threads that
+  // each run a copy of the engine and backend, and add their results to the
+  // engine. Partial counts are streamed as for run_circuit. Returns the
+  // number of shot threads.
+  template <class Engine, class Backend>
+  uint_t run_engine(Circuit &circ, Engine &engine, Backend &backend,
+                    uint_t rng_seed, std::ostream *out = nullptr,
+                    uint_t index = 0) const;
+
+  // Execute each parameter binding of a circuit with symbolic parameters.
+  // The bindings are evaluated in parallel, with each thread reusing one copy
+  // of the parsed circuit and one backend for all of its bindings.
   template <class Engine, class Backend>
-  json_t run_circuit(Circuit &circ) const;
+  json_t run_sweep(Circuit &circ, uint_t index = 0) const;
+
+private:
+  // Execute all quantum circuits, streaming results if out is not null
+  json_t execute_circuits(std::ostream *out);
+
+  // Builds a prefix trie over the operations of the circuits and sets
+  // checkpoints at its branch points so that each shared prefix is simulated
+  // once. Returns the order in which to execute the circuits, which is a
+  // depth first traversal of the trie.
+  std::vector<uint_t> share_prefixes();
+
+  // Share the checkpoint cache with an engine. Clifford states are not
+  // cached.
+  void attach_checkpoints(BaseEngine<cvector_t> &engine) const {
+    engine.checkpoint_cache = checkpoint_cache;
+  };
+  void attach_checkpoints(BaseEngine<Clifford> &engine) const { (void)engine; };
+
+  // Returns true if the shot branching snapshot of each shot thread fits in
+  // memory next to the states of the threads, for a circuit dq qubits smaller
+  // than the largest that fits in max_memory_gb
+  static bool snapshots_fit(uint_t threads, int_t dq) {
+    return 2 * threads <= (1ULL << std::min<int_t>(dq, 63));
+  };
+
+  // Set the initial and target states that a binary qobj stores outside the
+  // circuit config on an engine
+  void attach_states(const Circuit &circ, VectorEngine &engine) const;
+  void attach_states(const Circuit &circ, BaseEngine<Clifford> &engine) const;
 };
 
 /*******************************************************************************
@@ -88,7 +229,11 @@ public:
  *
  ******************************************************************************/
 
-json_t Simulator::execute() {
+json_t Simulator::execute() { return execute_circuits(nullptr); }
+
+void Simulator::execute(std::ostream &out) { execute_circuits(&out); }
+
+json_t Simulator::execute_circuits(std::ostream *out) {
 
   // Initialize ouput JSON
   std::chrono::time_point<myclock_t> start = myclock_t::now(); // start timer
@@ -100,24 +245,41 @@ json_t Simulator::execute() {
     ret["backend"] = std::string("local_qiskit_simulator");
   ret["simulator"] = simulator;
 
+  // Streamed output starts with a header line of the qobj values, followed
+  // by a line for each circuit result and a final line with the qobj status
+  if (out != nullptr) {
+    *out << ret.dump() << std::endl;
+    ret = json_t::object();
+  }
+
   // Choose simulator and execute circuits
   try {
     bool qobj_success = true;
-    for (auto &circ : circuits) {
-      json_t circ_res;
-
-      // Choose Simulator Backend
-      if (simulator == "clifford")
-        circ_res = run_circuit<BaseEngine<Clifford>, CliffordBackend>(circ);
-      else if (simulator == "ideal")
-        circ_res = run_circuit<SampleShotsEngine, IdealBackend>(circ);
-      else
-        circ_res = run_circuit<VectorEngine, QubitBackend>(circ);
+    std::vector<uint_t> order;
+    if (prefix_sharing && simulator != "clifford")
+      order = share_prefixes();
+    else
+      for (uint_t j = 0; j < circuits.size(); j++)
+        order.push_back(j);
+    std::vector<json_t> results(circuits.size());
+    for (const auto &j : order) {
+      json_t circ_res = execute_circuit(
+          circuits[j], j, result_cache ? result_keys[j] : std::string(), out);
 
       // Check results
       qobj_success &= circ_res["success"].get<bool>();
-      ret["result"].push_back(circ_res);
+      if (out != nullptr) {
+        json_t line;
+        line["index"] = j;
+        line["result"] = circ_res;
+        *out << line.dump() << std::endl;
+      } else
+        results[j] = std::move(circ_res);
     }
+    if (out == nullptr)
+      ret["result"] = std::move(results);
+    if (load_error.empty() == false)
+      throw std::runtime_error("unable to parse qobj, " + load_error);
     ret["time_taken"] =
         std::chrono::duration<double>(myclock_t::now() - start).count();
     ret["status"] = std::string("COMPLETED");
@@ -126,38 +288,481 @@ json_t Simulator::execute() {
     ret["success"] = false;
     ret["status"] = std::string("ERROR: ") + e.what();
   }
+  if (out != nullptr)
+    *out << ret.dump() << std::endl;
   return ret;
 }
 
 //------------------------------------------------------------------------------
-template <class Engine, class Backend>
-json_t Simulator::run_circuit(Circuit &circ) const {
+json_t Simulator::execute_circuit(Circuit &circ, uint_t index,
+                                  const std::string &result_key,
+                                  std::ostream *out) {
+  json_t circ_res;
+
+  // Look up the result of an identical earlier circuit. The result also
+  // depends on the number of threads through the RNG of each shot thread.
+  std::string key;
+  if (result_cache && result_key.empty() == false) {
+#ifdef _OPENMP
+    uint_t ncpus = omp_get_num_procs();
+#else
+    uint_t ncpus = std::thread::hardware_concurrency();
+#endif
+    if (max_threads > 0)
+      ncpus = std::min(ncpus, max_threads);
+    key = result_key + "_" + std::to_string(ncpus);
+  }
 
-  std::chrono::time_point<myclock_t> start = myclock_t::now(); // start timer
-  json_t ret;                                                  // results JSON
+  // Choose Simulator Backend
+  if (key.empty() == false && result_cache->find(key, circ_res))
+    circ_res["cache_hit"] = true;
+  else
+    circ_res = dispatch(circ, [&](auto type) {
+      using Type = decltype(type);
+      return run_circuit<typename Type::engine_t, typename Type::backend_t>(
+          circ, out, index);
+    });
+
+  // Store the result of a successful circuit
+  if (key.empty() == false && circ_res.count("cache_hit") == 0) {
+    if (circ_res["success"].get<bool>())
+      result_cache->insert(key, circ_res);
+    circ_res["cache_hit"] = false;
+  }
+  return circ_res;
+}
+
+//------------------------------------------------------------------------------
+template <class Visitor>
+auto Simulator::dispatch(const Circuit &circ, Visitor &&visit) const
+    -> decltype(visit(EngineType<VectorEngine, QubitBackend>())) {
+  if (simulator == "clifford")
+    return visit(EngineType<BaseEngine<Clifford>, CliffordBackend>());
+  if (circ.config.get<GradientEngine>().show_gradients &&
+      (simulator == "ideal" ||
+       JSON::check_key("noise_params", circ.config) == false))
+    // Gradients are computed by the adjoint method on the ideal backend
+    return visit(EngineType<GradientEngine, IdealBackend>());
+  if (simulator == "ideal")
+    return visit(EngineType<SampleShotsEngine, IdealBackend>());
+  if (circ.opt_meas &&
+      circ.config.get<VectorEngine>().show_state_data() == false)
+    // Sampled shots only report the state before the final measurements
+    // so for the qubit simulator they are used for count data only
+    return visit(EngineType<SampleShotsEngine, QubitBackend>());
+  return visit(EngineType<VectorEngine, QubitBackend>());
+}
+
+//------------------------------------------------------------------------------
+Circuit Simulator::load_circuit(const json_t &js,
+                                std::string &result_key) const {
+  // The circuit JSON text is the key of both caches
+  std::string text;
+  if (circuit_cache || result_cache)
+    text = js.dump();
+
+  Circuit circ;
+  if (!circuit_cache)
+    circ = Circuit(js, config, gateset);
+  else {
+    // Reuse circuits parsed for an earlier qobj
+    const std::string key = config.dump() + simulator;
+    const uint_t hash = fnv1a_hash(text.data(), text.size(),
+                                   fnv1a_hash(key.data(), key.size()));
+    const auto cached = circuit_cache->find(hash);
+    if (cached)
+      circ = *cached;
+    else {
+      circ = Circuit(js, config, gateset);
+      circuit_cache->insert(hash, circ);
+    }
+  }
+
+  // Content hash of a circuit with a fixed seed. The hash covers the circuit
+  // JSON, the merged config, the simulator and the build, using two FNV-1a
+  // hashes with different offsets to make collisions unlikely.
+  result_key.clear();
+  if (result_cache) {
+    std::string binary;
+    std::string shm;
+    JSON::get_value(binary, "output_binary", circ.config);
+    JSON::get_value(shm, "output_shm", circ.config);
+    if (circ.rng_seed >= 0 && binary.empty() && shm.empty()) {
+      text += circ.config.dump() + simulator + __DATE__ + __TIME__;
+      std::stringstream ss;
+      ss << std::hex << std::setfill('0') << std::setw(16)
+         << fnv1a_hash(text.data(), text.size()) << std::setw(16)
+         << fnv1a_hash(text.data(), text.size(), 0x84222325cbf29ce4ULL);
+      result_key = ss.str();
+    }
+  }
+  return circ;
+}
+
+//------------------------------------------------------------------------------
+double Simulator::memory_footprint() const {
+  double bytes = 0.;
+  if (simulator == "clifford")
+    return bytes; // tableaus are negligible
+  for (const auto &circ : circuits) {
+    const double state = 16. * std::pow(2., static_cast<double>(circ.nqubits));
+    const double density = state * state / 16.;
+    double nsaved = 0.;
+    for (const auto &op : circ.operations)
+      if (op.id == gate_t::Save)
+        nsaved++;
+    const VectorEngine eng = circ.config;
+    double circ_bytes = state * (2. + nsaved);
+    if (eng.show_final_density)
+      circ_bytes += density;
+    if (eng.show_saved_density)
+      circ_bytes += nsaved * density;
+    if (eng.show_final_ket)
+      circ_bytes += state * circ.shots;
+    if (eng.show_saved_ket)
+      circ_bytes += state * circ.shots * nsaved;
+    bytes = std::max(bytes, circ_bytes);
+  }
+  return bytes;
+}
+
+double Simulator::cache_footprint() const {
+  if (simulator == "clifford" || circuits.empty())
+    return 0.;
+  uint_t nqubits = 0;
+  for (const auto &circ : circuits)
+    nqubits = std::max(nqubits, circ.nqubits);
+  const double state = 16. * std::pow(2., static_cast<double>(nqubits));
+  if (checkpoint_cache)
+    return state * checkpoint_cache->capacity();
+  // Prefix sharing stores at most one snapshot per branch point of the trie,
+  // in at most half of the maximum memory
+  if (prefix_sharing)
+    return state * std::min(std::floor(0.5 * max_memory_gb * 1e9 / state),
+                            static_cast<double>(circuits.size() - 1));
+  return 0.;
+}
+
+//------------------------------------------------------------------------------
+std::vector<uint_t> Simulator::share_prefixes() {
+  const uint_t ncircs = circuits.size();
+  std::vector<uint_t> order(ncircs);
+  for (uint_t j = 0; j < ncircs; j++)
+    order[j] = j;
+
+  // Each circuit is compared as the sequence of the hashes of its operations
+  // up to the first operation with a symbolic parameter. The hash of the
+  // first operation also covers the circuit size and initial state.
+  uint_t nqubits = 0;
+  std::vector<std::vector<uint_t>> seqs(ncircs);
+  for (uint_t j = 0; j < ncircs; j++) {
+    const Circuit &circ = circuits[j];
+    nqubits = std::max(nqubits, circ.nqubits);
+    for (uint_t pos = 0; pos < circ.operations.size(); pos++) {
+      if (circ.operations[pos].symbols.empty() == false)
+        break;
+      seqs[j].push_back(circ.hash_operations(pos, pos + 1, 1));
+    }
+  }
+
+  // Half of the maximum memory is used for the snapshots at branch points
+  const double state_bytes = 16. * std::pow(2., static_cast<double>(nqubits));
+  const uint_t capacity =
+      static_cast<uint_t>(std::floor(0.5 * max_memory_gb * 1e9 / state_bytes));
+  if (ncircs < 2 || capacity == 0)
+    return order;
+
+  // Sorting the sequences orders the circuits by a depth first traversal of
+  // their prefix trie, in which the branch point between neighbours is their
+  // longest common prefix
+  std::stable_sort(order.begin(), order.end(), [&](uint_t a, uint_t b) {
+    return seqs[a] < seqs[b];
+  });
+  std::vector<uint_t> lcp(ncircs - 1);
+  for (uint_t k = 0; k + 1 < ncircs; k++) {
+    const auto &a = seqs[order[k]];
+    const auto &b = seqs[order[k + 1]];
+    uint_t n = 0;
+    while (n < a.size() && n < b.size() && a[n] == b[n])
+      n++;
+    lcp[k] = n;
+  }
+
+  // A circuit stores a checkpoint at each branch point on its path in the
+  // trie that a later circuit resumes from. These are the running minima of
+  // the common prefix lengths with the circuits that follow it, which are
+  // kept on a stack while traversing the circuits in reverse.
+  bool shared = false;
+  std::vector<uint_t> minima;
+  for (uint_t k = ncircs - 1; k-- > 0;) {
+    while (minima.empty() == false && minima.back() >= lcp[k])
+      minima.pop_back();
+    if (lcp[k] > 0)
+      minima.push_back(lcp[k]);
+    Circuit &circ = circuits[order[k]];
+    for (const auto &depth : minima)
+      circ.config["checkpoints"].push_back(depth);
+    shared |= (minima.empty() == false);
+  }
+  if (shared == false)
+    return order;
+
+  // Unless a checkpoint cache was requested only branch points are stored
+  if (!checkpoint_cache) {
+    checkpoint_cache =
+        std::make_shared<BaseEngine<cvector_t>::checkpoint_cache_t>(capacity);
+    for (auto &circ : circuits)
+      circ.config["checkpoint_prefix"] = false;
+  }
+  return order;
+}
+
+//------------------------------------------------------------------------------
+void Simulator::attach_states(const Circuit &circ, VectorEngine &engine) const {
+  if (circ.initial_state) {
+    engine.initial_state = *circ.initial_state;
+    engine.initial_state_flag = true;
+    renormalize(engine.initial_state);
+  }
+  if (circ.target_states) {
+    engine.target_states = *circ.target_states;
+    bool renorm_target_states = true;
+    JSON::get_value(renorm_target_states, "renorm_target_states", circ.config);
+    if (renorm_target_states)
+      for (auto &v : engine.target_states)
+        renormalize(v);
+  }
+}
+
+void Simulator::attach_states(const Circuit &circ,
+                              BaseEngine<Clifford> &engine) const {
+  (void)engine;
+  if (circ.initial_state || circ.target_states)
+    throw std::runtime_error("the clifford simulator does not support "
+                             "binary state vectors");
+}
 
-  // Check max qubits
+//------------------------------------------------------------------------------
+void Simulator::check_memory(const Circuit &circ) const {
   uint_t max_qubits =
       static_cast<uint_t>(floor(log2(max_memory_gb * 1e9 / 16.)));
   if ((simulator == "qubit" || simulator == "ideal") &&
       circ.nqubits > max_qubits) {
-    ret["success"] = false;
     std::stringstream msg;
-    msg << "ERROR: Number of qubits (" << circ.nqubits
+    msg << "Number of qubits (" << circ.nqubits
         << ") exceeds maximum memory (" << max_memory_gb << " GB).";
-    ret["status"] = msg.str();
-    return ret;
+    throw std::runtime_error(msg.str());
   }
+}
+
+//------------------------------------------------------------------------------
+template <class Engine, class Backend>
+json_t Simulator::run_circuit(Circuit &circ, std::ostream *out,
+                              uint_t index) const {
+
+  std::chrono::time_point<myclock_t> start = myclock_t::now(); // start timer
+  json_t ret;                                                  // results JSON
 
   // Try to execute circuit
   try {
+    check_memory(circ);
+    if (circ.parameter_binds.empty() == false)
+      return run_sweep<Engine, Backend>(circ, index);
+
     // Initialize reference engine and backend from JSON config
     Engine engine = circ.config;
     Backend backend = circ.config;
+    setup_engine(circ, engine, index);
 
     // Set RNG Seed
     uint_t rng_seed = (circ.rng_seed < 0) ? std::random_device()()
                                           : static_cast<uint_t>(circ.rng_seed);
+    const uint_t threads =
+        run_engine(circ, engine, backend, rng_seed, out, index);
+
+    // Return results
+    ret["data"] = engine; // add engine output to return
+    if (simulator != "ideal" && JSON::check_key("noise_params", circ.config)) {
+      ret["noise_params"] = backend.noise;
+    }
+
+    // Add time taken and return result
+    ret["data"]["time_taken"] =
+        std::chrono::duration<double>(myclock_t::now() - start).count();
+    // Add metadata
+    ret["name"] = circ.name;
+    ret["shots"] = circ.shots;
+    ret["seed"] = rng_seed;
+    if (threads > 1)
+      ret["threads_shot"] = threads;
+    // Report success
+    ret["success"] = true;
+    ret["status"] = std::string("DONE");
+  } catch (std::exception &e) {
+    ret["success"] = false;
+    ret["status"] = std::string("ERROR: ") + e.what();
+  }
+
+  return ret;
+}
+
+//------------------------------------------------------------------------------
+template <class Engine>
+void Simulator::setup_engine(const Circuit &circ, Engine &engine,
+                             uint_t index) const {
+  attach_checkpoints(engine);
+  attach_states(circ, engine);
+
+  // Binary output files and shared memory segments are named by the
+  // circuit index in the qobj
+  if (engine.output_binary.empty() == false)
+    engine.output_binary += "_" + std::to_string(index);
+  if (engine.output_shm.empty() == false)
+    engine.output_shm += "_" + std::to_string(index);
+}
+
+//------------------------------------------------------------------------------
+template <class Engine, class Backend>
+uint_t Simulator::run_engine(Circuit &circ, Engine &engine, Backend &backend,
+                             uint_t rng_seed, std::ostream *out,
+                             uint_t index) const {
+  const uint_t max_qubits =
+      static_cast<uint_t>(floor(log2(max_memory_gb * 1e9 / 16.)));
+
+// Thread number
+#ifdef _OPENMP
+  uint_t ncpus = omp_get_num_procs(); // OMP method
+  omp_set_nested(1);                  // allow nested parallel threads
+#else
+  uint_t ncpus = std::thread::hardware_concurrency(); // C++11 method
+#endif
+  ncpus = std::max(1ULL, ncpus); // check 0 edge case
+  if (max_threads > 0)
+    ncpus = std::min(ncpus, max_threads);
+  int_t dq = (max_qubits > circ.nqubits) ? max_qubits - circ.nqubits : 0;
+  uint_t threads = std::max<uint_t>(1UL, 2 * dq);
+  if (engine.sample_measurements(circ, &backend))
+    threads = 1; // single shot thread
+  else {
+    threads = std::min<uint_t>(threads, ncpus);
+    threads = std::min<uint_t>(threads, circ.shots);
+    if (max_threads_shot > 0)
+      threads = std::min<uint_t>(max_threads_shot, threads);
+  }
+  if (snapshots_fit(threads, dq) == false)
+    engine.shot_branching = false;
+  uint_t gate_threads = std::max<uint_t>(1UL, ncpus / threads);
+  if (max_threads_gate > 0)
+    gate_threads = std::min<uint_t>(max_threads_gate, gate_threads);
+
+  // Shots are run in batches when partial counts are streamed
+  uint_t batch = circ.shots;
+  if (out != nullptr && stream_shots > 0 &&
+      engine.sample_measurements(circ, &backend) == false)
+    batch = std::max<uint_t>(1ULL, stream_shots);
+  auto stream_partial = [&](const counts_t &counts, uint_t shots) {
+    json_t line;
+    line["index"] = index;
+    line["partial"]["shots"] = shots;
+    line["partial"]["counts"] = counts;
+    *out << line.dump() << std::endl;
+  };
+
+  // Single-threaded shots loop
+  if (threads < 2) {
+    // Run shots on single-thread
+    backend.set_rng_seed(rng_seed);
+    uint_t done = 0;
+    do {
+      const uint_t n = std::min(batch, circ.shots - done);
+      engine.run_program(circ, &backend, n, gate_threads);
+      done += n;
+      if (done < circ.shots)
+        stream_partial(engine.merged_counts(), done);
+    } while (done < circ.shots);
+  }
+  // Parallelized shots loop
+  else {
+    // Set rng seed for each thread
+    std::vector<std::pair<uint_t, uint_t>> shotseed;
+    for (uint_t j = 0; j < threads; ++j)
+      shotseed.push_back(std::make_pair(circ.shots / threads, rng_seed + j));
+    shotseed[0].first += (circ.shots % threads);
+
+    // Each batch is split evenly over the shot threads, which keep their
+    // backend between batches to continue the same RNG stream
+    const uint_t thread_batch =
+        (batch < circ.shots) ? (batch + threads - 1) / threads
+                             : shotseed[0].first;
+    std::vector<Engine> futures(threads, engine);
+    std::vector<Backend> backends(threads, backend);
+    for (uint_t j = 0; j < threads; j++)
+      backends[j].set_rng_seed(shotseed[j].second);
+    uint_t done = 0;
+    do {
+      std::vector<uint_t> nshots(threads);
+      for (uint_t j = 0; j < threads; j++) {
+        nshots[j] = std::min(thread_batch, shotseed[j].first);
+        shotseed[j].first -= nshots[j];
+        done += nshots[j];
+      }
+
+// OMP Execution
+#ifdef _OPENMP
+#pragma omp parallel for if (threads > 1) num_threads(threads)
+      for (uint_t j = 0; j < threads; j++)
+        futures[j].run_program(circ, &backends[j], nshots[j], gate_threads);
+
+// C++11 Execution
+#else
+      std::vector<std::future<void>> tasks;
+      for (uint_t j = 0; j < threads; j++)
+        tasks.push_back(async(std::launch::async, [&, j]() {
+          futures[j].run_program(circ, &backends[j], nshots[j]);
+        }));
+      for (auto &&t : tasks)
+        t.get();
+#endif
+      if (done < circ.shots) {
+        counts_t counts;
+        for (const auto &f : futures)
+          for (const auto &pair : f.merged_counts())
+            counts[pair.first] += pair.second;
+        stream_partial(counts, done);
+      }
+    } while (done < circ.shots);
+
+    // collect results by pairwise reduction, moving the results of each
+    // pair into the lower thread index to keep the order of shots
+    for (uint_t stride = 1; stride < threads; stride *= 2) {
+      const int_t npairs = (threads - stride + 2 * stride - 1) / (2 * stride);
+#pragma omp parallel for if (npairs > 1) num_threads(npairs)
+      for (int_t k = 0; k < npairs; k++) {
+        const uint_t j = 2 * stride * k;
+        futures[j] += std::move(futures[j + stride]);
+      }
+    }
+    engine += std::move(futures[0]);
+  } // end parallel shots
+
+  return threads;
+}
+
+//------------------------------------------------------------------------------
+template <class Engine, class Backend>
+json_t Simulator::run_sweep(Circuit &circ, uint_t index) const {
+
+  std::chrono::time_point<myclock_t> start = myclock_t::now(); // start timer
+  json_t ret;                                                  // results JSON
+
+  try {
+    // Initialize reference engine and backend from JSON config
+    Engine engine = circ.config;
+    attach_checkpoints(engine);
+    attach_states(circ, engine);
+    const Backend backend = circ.config;
+    uint_t rng_seed = (circ.rng_seed < 0) ? std::random_device()()
+                                          : static_cast<uint_t>(circ.rng_seed);
 
 // Thread number
 #ifdef _OPENMP
@@ -167,88 +772,81 @@ json_t Simulator::run_circuit(Circuit &circ) const {
     uint_t ncpus = std::thread::hardware_concurrency(); // C++11 method
 #endif
     ncpus = std::max(1ULL, ncpus); // check 0 edge case
+    if (max_threads > 0)
+      ncpus = std::min(ncpus, max_threads);
+    const uint_t nbinds = circ.parameter_binds.size();
+    uint_t max_qubits =
+        static_cast<uint_t>(floor(log2(max_memory_gb * 1e9 / 16.)));
     int_t dq = (max_qubits > circ.nqubits) ? max_qubits - circ.nqubits : 0;
     uint_t threads = std::max<uint_t>(1UL, 2 * dq);
-    if (simulator == "ideal" && circ.opt_meas)
-      threads = 1; // single shot thread
-    else {
-      threads = std::min<uint_t>(threads, ncpus);
-      threads = std::min<uint_t>(threads, circ.shots);
-      if (max_threads_shot > 0)
-        threads = std::min<uint_t>(max_threads_shot, threads);
-    }
+    threads = std::min<uint_t>(threads, ncpus);
+    threads = std::min<uint_t>(threads, nbinds);
+    if (max_threads_shot > 0)
+      threads = std::min<uint_t>(max_threads_shot, threads);
+    if (snapshots_fit(threads, dq) == false)
+      engine.shot_branching = false;
     uint_t gate_threads = std::max<uint_t>(1UL, ncpus / threads);
     if (max_threads_gate > 0)
       gate_threads = std::min<uint_t>(max_threads_gate, gate_threads);
 
-    // Single-threaded shots loop
-    if (threads < 2) {
-      // Run shots on single-thread
-      backend.set_rng_seed(rng_seed);
-      engine.run_program(circ, &backend, circ.shots, gate_threads);
-    }
-    // Parallelized shots loop
-    else {
-      // Set rng seed for each thread
-      std::vector<std::pair<uint_t, uint_t>> shotseed;
-      for (uint_t j = 0; j < threads; ++j)
-        shotseed.push_back(std::make_pair(circ.shots / threads, rng_seed + j));
-      shotseed[0].first += (circ.shots % threads);
+    // Each thread evaluates every threads-th binding. Binding k uses the seed
+    // rng_seed + k so results do not depend on the number of threads.
+    std::vector<json_t> binds(nbinds);
+    std::vector<std::string> errors(threads);
+    auto run_binds = [&](uint_t thread) {
+      try {
+        Circuit bcirc = circ;
+        Backend bbackend = backend;
+        for (uint_t k = thread; k < nbinds; k += threads) {
+          bcirc.bind_parameters(k);
+          Engine eng = engine;
+          if (eng.output_binary.empty() == false)
+            eng.output_binary +=
+                "_" + std::to_string(index) + "_" + std::to_string(k);
+          if (eng.output_shm.empty() == false)
+            eng.output_shm +=
+                "_" + std::to_string(index) + "_" + std::to_string(k);
+          bbackend.set_rng_seed(rng_seed + k);
+          eng.run_program(bcirc, &bbackend, bcirc.shots, gate_threads);
+          binds[k] = eng;
+        }
+      } catch (std::exception &e) {
+        errors[thread] = e.what();
+      }
+    };
 
 // OMP Execution
 #ifdef _OPENMP
-      std::vector<Engine> futures(threads);
 #pragma omp parallel for if (threads > 1) num_threads(threads)
-      for (uint_t j = 0; j < threads; j++) {
-        const auto &ss = shotseed[j];
-        Backend be(backend);
-        be.set_rng_seed(ss.second);
-        futures[j] = engine;
-        futures[j].run_program(circ, &be, ss.first, gate_threads);
-      }
-      for (auto &f : futures)
-        engine += f;
-
+    for (uint_t j = 0; j < threads; j++)
+      run_binds(j);
 // C++11 Execution
 #else
-      std::vector<std::future<Engine>> futures;
-      for (auto &&ss : shotseed)
-        futures.push_back(async(std::launch::async, [&]() {
-          Engine eng(engine);
-          Backend be(backend);
-          be.set_rng_seed(ss.second);
-          eng.run_program(circ, &be, ss.first);
-          return eng;
-        }));
-      // collect results
-      for (auto &&f : futures)
-        engine += f.get();
+    std::vector<std::future<void>> tasks;
+    for (uint_t j = 0; j < threads; j++)
+      tasks.push_back(async(std::launch::async, [&, j]() { run_binds(j); }));
+    for (auto &&t : tasks)
+      t.get();
 #endif
-    } // end parallel shots
+    for (const auto &err : errors)
+      if (err.empty() == false)
+        throw std::runtime_error(err);
 
     // Return results
-    ret["data"] = engine; // add engine output to return
-    if (simulator != "ideal" && JSON::check_key("noise_params", circ.config)) {
-      ret["noise_params"] = backend.noise;
-    }
-
-    // Add time taken and return result
+    ret["data"]["parameter_binds"] = binds;
     ret["data"]["time_taken"] =
         std::chrono::duration<double>(myclock_t::now() - start).count();
-    // Add metadata
     ret["name"] = circ.name;
     ret["shots"] = circ.shots;
     ret["seed"] = rng_seed;
     if (threads > 1)
-      ret["threads_shot"] = threads;
-    // Report success
+      ret["threads_binds"] = threads;
     ret["success"] = true;
     ret["status"] = std::string("DONE");
   } catch (std::exception &e) {
     ret["success"] = false;
     ret["status"] = std::string("ERROR: ") + e.what();
   }
-
   return ret;
 }
 
@@ -275,11 +873,22 @@ inline bool check_qobj(const json_t &qobj) {
 }
 
 //------------------------------------------------------------------------------
+/**
+ * Loads a qobj into a simulator. Any circuit and checkpoint caches already
+ * set on the simulator are kept, so a persistent process can share them
+ * between qobjs, and the circuits are not loaded if load_circuits is false.
+ */
 inline void from_json(const json_t &js, Simulator &qobj) {
   try {
     if (check_qobj(js)) { // check valid qobj
 
+      const auto circuit_cache = qobj.circuit_cache;
+      const auto checkpoint_cache = qobj.checkpoint_cache;
+      const bool load_circuits = qobj.load_circuits;
       qobj = Simulator();
+      qobj.circuit_cache = circuit_cache;
+      qobj.checkpoint_cache = checkpoint_cache;
+      qobj.load_circuits = load_circuits;
       JSON::get_value(qobj.id, "id", js);
 
       json_t config;
@@ -289,6 +898,19 @@ inline void from_json(const json_t &js, Simulator &qobj) {
       JSON::get_value(qobj.max_memory_gb, "max_memory", config);
       JSON::get_value(qobj.max_threads_shot, "max_threads_shot", config);
       JSON::get_value(qobj.max_threads_gate, "max_threads_gate", config);
+      JSON::get_value(qobj.max_threads, "max_threads", config);
+
+      // Streaming output
+      JSON::get_value(qobj.stream_output, "stream_output", config);
+      JSON::get_value(qobj.stream_shots, "stream_shots", config);
+
+      // Checkpoint cache and prefix sharing between circuits
+      JSON::get_value(qobj.prefix_sharing, "prefix_sharing", config);
+      uint_t checkpoints = 0;
+      JSON::get_value(checkpoints, "checkpoint_cache", config);
+      if (checkpoints > 0 && !qobj.checkpoint_cache)
+        qobj.checkpoint_cache = std::make_shared<
+            BaseEngine<cvector_t>::checkpoint_cache_t>(checkpoints);
 
       // Override with user simulator backend specification
       JSON::get_value(qobj.simulator, "simulator", config);
@@ -306,10 +928,75 @@ inline void from_json(const json_t &js, Simulator &qobj) {
         throw std::runtime_error(std::string("invalid simulator."));
       }
 
+      // Result cache directory and its size limit in MB
+      std::string result_dir;
+      uint_t result_mb = 1024;
+      JSON::get_value(result_dir, "result_cache", config);
+      JSON::get_value(result_mb, "result_cache_size", config);
+      if (result_dir.empty() == false)
+        qobj.result_cache =
+            std::make_shared<ResultCache>(result_dir, result_mb << 20);
+
       // Load unrolled qasm circuits
-      const json_t &circs = js["circuits"];
-      for (auto it = circs.cbegin(); it != circs.cend(); ++it)
-        qobj.circuits.push_back(Circuit(*it, config, gateset));
+      qobj.config = std::move(config);
+      qobj.gateset = std::move(gateset);
+      if (qobj.load_circuits) {
+        // Circuits are constructed in parallel in their qobj order. If any
+        // fail only the circuits before the first one are kept, and its error
+        // is reported once they have been run.
+        const json_t &circs = js["circuits"];
+        const uint_t ncircs = circs.size();
+        qobj.circuits.resize(ncircs);
+        std::vector<std::string> keys(ncircs);
+        std::vector<std::string> errors(ncircs);
+        std::atomic<uint_t> first_error(ncircs);
+        auto load = [&](uint_t j) {
+          if (j > first_error)
+            return;
+          try {
+            qobj.circuits[j] = qobj.load_circuit(circs[j], keys[j]);
+          } catch (std::exception &e) {
+            errors[j] = e.what();
+            uint_t first = first_error;
+            while (j < first && !first_error.compare_exchange_weak(first, j))
+              ;
+          }
+        };
+
+#ifdef _OPENMP
+        uint_t ncpus = omp_get_num_procs();
+#else
+        uint_t ncpus = std::thread::hardware_concurrency();
+#endif
+        ncpus = std::max(1ULL, ncpus);
+        if (qobj.max_threads > 0)
+          ncpus = std::min(ncpus, qobj.max_threads);
+        const uint_t threads = std::min(ncpus, ncircs);
+
+// OMP Execution
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if (threads > 1) num_threads(threads)
+        for (int_t j = 0; j < static_cast<int_t>(ncircs); j++)
+          load(j);
+// C++11 Execution
+#else
+        std::vector<std::future<void>> tasks;
+        for (uint_t t = 0; t < threads; t++)
+          tasks.push_back(async(std::launch::async, [&, t]() {
+            for (uint_t j = t; j < ncircs; j += threads)
+              load(j);
+          }));
+        for (auto &&t : tasks)
+          t.get();
+#endif
+        if (first_error < ncircs) {
+          qobj.circuits.resize(first_error);
+          keys.resize(first_error);
+          qobj.load_error = errors[first_error];
+        }
+        if (qobj.result_cache)
+          qobj.result_keys = std::move(keys);
+      }
     } else {
       throw std::runtime_error(std::string("invalid qobj file."));
     }
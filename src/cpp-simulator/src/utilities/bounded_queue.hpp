@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    bounded_queue.hpp
+ * @brief   Blocking queue of bounded capacity between pipeline stages
+ */
+
+#ifndef _bounded_queue_h_
+#define _bounded_queue_h_
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include "types.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * BoundedQueue class
+  *
+  * A first in first out queue shared by a producer and a consumer thread. A
+  * push blocks while the queue is full, so a fast producer is held at most
+  * capacity items ahead of its consumer, and a pop blocks while it is empty.
+  * Closing the queue wakes both sides: later pushes are dropped, and pops
+  * return the remaining items and then fail.
+  *
+  ******************************************************************************/
+
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(uint_t capacity)
+      : capacity_(std::max<uint_t>(1, capacity)){};
+
+  /**
+   * Appends an item, blocking while the queue is full.
+   * @returns: false if the queue was closed and the item dropped.
+   */
+  bool push(T item);
+
+  /**
+   * Removes the first item, blocking while the queue is empty.
+   * @returns: false if the queue is closed and empty.
+   */
+  bool pop(T &item);
+
+  // Stops the queue from accepting items and wakes all waiting threads
+  void close();
+
+private:
+  uint_t capacity_;
+  bool closed_ = false;
+  std::deque<T> items_;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
+
+/*******************************************************************************
+ *
+ * BoundedQueue methods
+ *
+ ******************************************************************************/
+
+template <typename T> bool BoundedQueue<T>::push(T item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_full_.wait(lock,
+                 [this]() { return closed_ || items_.size() < capacity_; });
+  if (closed_)
+    return false;
+  items_.push_back(std::move(item));
+  not_empty_.notify_one();
+  return true;
+}
+
+template <typename T> bool BoundedQueue<T>::pop(T &item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_empty_.wait(lock, [this]() { return closed_ || items_.empty() == false; });
+  if (items_.empty())
+    return false;
+  item = std::move(items_.front());
+  items_.pop_front();
+  not_full_.notify_one();
+  return true;
+}
+
+template <typename T> void BoundedQueue<T>::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = true;
+  not_full_.notify_all();
+  not_empty_.notify_all();
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+
+#endif
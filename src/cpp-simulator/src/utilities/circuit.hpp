@@ -24,9 +24,11 @@ limitations under the License.
 #define _circuit_h_
 
 #include <algorithm>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "misc.hpp"
@@ -70,12 +72,26 @@ public:
   gate_t id;
   std::string name;
   std::vector<double> params;
+  std::map<uint_t, std::string> symbols; // symbolic params by position
   creg_t qubits;
   creg_t clbits;
   bool if_op = false;
   operation_if cond;
 };
 
+/*******************************************************************************
+ *
+ * parameter_ref struct
+ *
+ ******************************************************************************/
+
+struct parameter_ref {
+public:
+  uint_t op;        // index of the operation
+  uint_t param;     // index of the parameter in the operation params
+  std::string name; // symbolic name of the parameter
+};
+
 /*******************************************************************************
  *
  * Circuit class
@@ -98,6 +114,16 @@ public:
   bool opt_meas = false; // true if all measurements at end
   json_t config;         // local config
 
+  // Symbolic gate parameters and the values to bind to them for each
+  // circuit of a parameter sweep
+  std::vector<parameter_ref> parameters;
+  std::vector<std::map<std::string, double>> parameter_binds;
+
+  // Initial and target states read from a binary qobj as raw arrays, which
+  // replace the "initial_state" and "target_states" of the config
+  std::shared_ptr<const cvector_t> initial_state;
+  std::shared_ptr<const std::vector<cvector_t>> target_states;
+
   /**
    * Default Constructor
    */
@@ -126,11 +152,58 @@ public:
   void parse(const json_t &circuit, const json_t &qobjconf,
              const gateset_t &gs);
 
+  /**
+   * Loads the number of qubits and clbits and the register labels from the
+   * header of a json qobj circuit.
+   */
+  void parse_header(const json_t &header);
+
+  /**
+   * Checks an operation and appends it to the circuit. This is used by
+   * parsers that read the fields of an operation themselves, and must be
+   * called after parse_header.
+   * @param op: the operation with its params, symbols, qubits and clbits.
+   * @param label: the operation name.
+   * @param gs: the gateset of the simulator backend.
+   * @param jcond: the json qobj conditional of the operation, or null.
+   */
+  void add_operation(operation &&op, const std::string &label,
+                     const gateset_t &gs, const json_t &jcond);
+
+  /**
+   * Completes a circuit once its header and operations are loaded. The
+   * circuit config overrides the qobj config, measurements are deferred if
+   * possible, and the symbolic parameters are recorded.
+   * @param circconf: the circuit level config, or null.
+   * @param qobjconf: the qobj level config.
+   * @param gs: the gateset of the simulator backend.
+   */
+  void set_config(const json_t &circconf, const json_t &qobjconf,
+                  const gateset_t &gs);
+
+  /**
+   * Sets the value of all symbolic parameters from a parameter binding.
+   * @param pos: the index of the binding in parameter_binds.
+   */
+  void bind_parameters(uint_t pos);
+
+  /**
+   * Hashes the operations [first, last) of the circuit, including their bound
+   * parameter values, continuing from the hash of the preceding operations.
+   * For first = 0 the hash also covers the number of qubits and clbits and
+   * any initial state in the config.
+   * @param first: the index of the first operation to hash.
+   * @param last: one past the index of the last operation to hash.
+   * @param hash: the hash of the operations [0, first).
+   * @returns: the hash of the operations [0, last).
+   */
+  uint_t hash_operations(uint_t first, uint_t last, uint_t hash = 0) const;
+
 private:
   /**
-   *  Parse a json qobj circuit operation
+   *  Parse a json qobj circuit operation and append it to the circuit
    */
-  operation parse_op(const json_t &js, const gateset_t &gs);
+  void parse_op(const json_t &js, const gateset_t &gs);
 
   /**
    *  Parse a json qobj circuit operation conditional
@@ -151,6 +224,35 @@ private:
    *  Return true if tail of circuit operaitons are all measurements
    */
   bool check_opt_meas();
+
+  /**
+   * Moves measurements to the tail of the circuit if they commute with all
+   * later operations. Measurements commute with barriers and with operations
+   * on other qubits, and for ideal circuits with operations diagonal on the
+   * measured qubit. For ideal circuits single bit conditional x and z gates
+   * are also replaced by controlled gates by the deferred measurement
+   * principle. The circuit is left unchanged if any measurement cannot be
+   * moved.
+   * @param gs: the gateset of the simulator backend
+   * @param ideal: true if the circuit has no noise
+   * @returns: true if the operations were reordered
+   */
+  bool defer_measurements(const gateset_t &gs, bool ideal);
+
+  /**
+   * Returns true if an operation commutes with a measurement of a qubit
+   */
+  bool commutes_with_measure(const operation &op, uint_t qubit,
+                             bool ideal) const;
+
+  /**
+   * Replaces a single bit conditional x or z gate by a gate controlled on the
+   * measured qubit last recorded in the condition clbit.
+   * @param tail: measurements deferred to the end of the circuit
+   * @returns: true if the operation was replaced
+   */
+  bool defer_conditional(operation &op, const std::vector<operation> &tail,
+                         const gateset_t &gs);
 };
 
 /*******************************************************************************
@@ -165,8 +267,27 @@ void Circuit::parse(const json_t &circuit, const json_t &qobjconf,
   std::clog << "DEBUG (json): parsing circuit object" << std::endl;
 #endif
   // Parse header
-  const json_t &header = circuit["compiled_circuit"]["header"];
+  parse_header(circuit["compiled_circuit"]["header"]);
+
+#ifdef DEBUG
+  std::clog << "DEBUG (json): parsing operations" << std::endl;
+#endif
+
+  // parse operations
+  const json_t &ops = circuit["compiled_circuit"]["operations"];
+  for (auto it = ops.begin(); it != ops.end(); ++it)
+    parse_op(*it, gs);
 
+  // Load optional values
+  JSON::get_value(name, "name", circuit); // look for circuit name
+
+  // Parse Config
+  set_config(JSON::check_key("config", circuit) ? circuit["config"] : json_t(),
+             qobjconf, gs);
+}
+
+//------------------------------------------------------------------------------
+void Circuit::parse_header(const json_t &header) {
   JSON::get_value(nqubits, "number_of_qubits", header);
   JSON::get_value(nclbits, "number_of_clbits", header);
   qubit_labels = parse_reglist(header.at("qubit_labels"));
@@ -203,23 +324,15 @@ void Circuit::parse(const json_t &circuit, const json_t &qobjconf,
   }
 #ifdef DEBUG
   std::clog << "DEBUG (json): clbit_labels = " << clbit_labels << std::endl;
-  std::clog << "DEBUG (json): parsing operations" << std::endl;
 #endif
+}
 
-  // parse operations
-  const json_t &ops = circuit["compiled_circuit"]["operations"];
-  for (auto it = ops.begin(); it != ops.end(); ++it)
-    operations.push_back(parse_op(*it, gs));
-  opt_meas = check_opt_meas(); // check measurement optimization
-
-  // Load optional values
-  JSON::get_value(name, "name", circuit); // look for circuit name
-
-  // Parse Config
+//------------------------------------------------------------------------------
+void Circuit::set_config(const json_t &circconf, const json_t &qobjconf,
+                         const gateset_t &gs) {
   config = qobjconf; // copy qobj level config
-  if (JSON::check_key("config", circuit)) {
-    for (auto it = circuit["config"].cbegin(); it != circuit["config"].cend();
-         ++it) {
+  if (circconf.is_object()) {
+    for (auto it = circconf.cbegin(); it != circconf.cend(); ++it) {
       config[it.key()] = it.value(); // overwrite circuit level config values
     }
   }
@@ -227,6 +340,61 @@ void Circuit::parse(const json_t &circuit, const json_t &qobjconf,
   // load config
   JSON::get_value(shots, "shots", config);
   JSON::get_value(rng_seed, "seed", config);
+
+  // check measurement optimization
+  defer_measurements(gs, JSON::check_key("noise_params", config) == false);
+  opt_meas = check_opt_meas();
+
+  // Symbolic parameters are recorded after any reordering of operations
+  for (uint_t j = 0; j < operations.size(); j++)
+    for (const auto &sym : operations[j].symbols)
+      parameters.push_back({j, sym.first, sym.second});
+  JSON::get_value(parameter_binds, "parameter_binds", config);
+  if (parameters.empty() == false && parameter_binds.empty())
+    throw std::runtime_error("circuit has symbolic parameters but no "
+                             "\"parameter_binds\"");
+  for (const auto &bind : parameter_binds)
+    for (const auto &par : parameters)
+      if (bind.find(par.name) == bind.end())
+        throw std::runtime_error("parameter \"" + par.name +
+                                 "\" is missing from a parameter binding");
+}
+
+//------------------------------------------------------------------------------
+void Circuit::bind_parameters(uint_t pos) {
+  const auto &bind = parameter_binds[pos];
+  for (const auto &par : parameters)
+    operations[par.op].params[par.param] = bind.at(par.name);
+}
+
+//------------------------------------------------------------------------------
+uint_t Circuit::hash_operations(uint_t first, uint_t last, uint_t hash) const {
+  if (first == 0) {
+    hash = fnv1a_hash(&nqubits, sizeof(nqubits));
+    hash = fnv1a_hash(&nclbits, sizeof(nclbits), hash);
+    if (JSON::check_key("initial_state", config)) {
+      const std::string init = config["initial_state"].dump();
+      hash = fnv1a_hash(init.data(), init.size(), hash);
+    }
+    if (initial_state)
+      hash = fnv1a_hash(initial_state->data(),
+                        initial_state->size() * sizeof(complex_t), hash);
+  }
+  for (uint_t pos = first; pos < last; pos++) {
+    const operation &op = operations[pos];
+    hash = fnv1a_hash(&op.id, sizeof(op.id), hash);
+    hash = fnv1a_hash(op.qubits.data(), op.qubits.size() * sizeof(uint_t),
+                      hash);
+    hash = fnv1a_hash(op.clbits.data(), op.clbits.size() * sizeof(uint_t),
+                      hash);
+    hash = fnv1a_hash(op.params.data(), op.params.size() * sizeof(double),
+                      hash);
+    // separate the operations so different splits of the lists differ
+    const uint_t sizes[3] = {op.qubits.size(), op.clbits.size(),
+                             op.params.size()};
+    hash = fnv1a_hash(sizes, sizeof(sizes), hash);
+  }
+  return hash;
 }
 
 //------------------------------------------------------------------------------
@@ -242,23 +410,45 @@ bool Circuit::set_gateid(operation &op, std::string label,
 }
 
 //------------------------------------------------------------------------------
-operation Circuit::parse_op(const json_t &node, const gateset_t &gs) {
+void Circuit::parse_op(const json_t &node, const gateset_t &gs) {
 
   operation op;
   std::string label;
 
-  // Check operation is in the gateset
-  if (!(node.is_object() && JSON::get_value(label, "name", node) &&
-        set_gateid(op, label, gs))) {
+  // Check operation has a name
+  if (!(node.is_object() && JSON::get_value(label, "name", node))) {
     throw std::runtime_error(
         std::string("invalid operation \'" + label + "\'."));
   }
 
-  // load op parameters
-  JSON::get_value(op.params, "params", node);
+  // load op parameters, which are numbers or the names of symbolic
+  // parameters bound for each circuit of a parameter sweep
+  if (JSON::check_key("params", node)) {
+    for (const auto &par : node["params"]) {
+      if (par.is_string()) {
+        op.symbols[op.params.size()] = par.get<std::string>();
+        op.params.push_back(0.);
+      } else
+        op.params.push_back(par.get<double>());
+    }
+  }
   JSON::get_value(op.qubits, "qubits", node);
   JSON::get_value(op.clbits, "clbits", node);
 
+  add_operation(std::move(op), label, gs,
+                JSON::check_key("conditional", node) ? node["conditional"]
+                                                     : json_t());
+}
+
+//------------------------------------------------------------------------------
+void Circuit::add_operation(operation &&op, const std::string &label,
+                            const gateset_t &gs, const json_t &jcond) {
+  // Check operation is in the gateset
+  if (set_gateid(op, label, gs) == false) {
+    throw std::runtime_error(
+        std::string("invalid operation \'" + label + "\'."));
+  }
+
   // Check op
   for (auto q : op.qubits)
     if (q >= nqubits) {
@@ -283,12 +473,12 @@ operation Circuit::parse_op(const json_t &node, const gateset_t &gs) {
 #endif
 
   // Load if operation parameters
-  if (JSON::check_key("conditional", node)) {
-    op.cond = parse_conditional(node["conditional"]);
+  if (jcond.is_null() == false) {
+    op.cond = parse_conditional(jcond);
     op.if_op = true;
   }
 
-  return op;
+  operations.push_back(std::move(op));
 }
 
 //------------------------------------------------------------------------------
@@ -340,7 +530,7 @@ reglist Circuit::parse_reglist(const json_t &node) {
 bool Circuit::check_opt_meas() {
   // find first instance of a measurement
   uint_t pos = 0;
-  while (operations[pos].id != gate_t::Measure && pos < operations.size()) {
+  while (pos < operations.size() && operations[pos].id != gate_t::Measure) {
     pos++;
   }
   // Check all remaining operations are also measurements
@@ -350,6 +540,104 @@ bool Circuit::check_opt_meas() {
   return pass;
 }
 
+//------------------------------------------------------------------------------
+bool Circuit::defer_measurements(const gateset_t &gs, bool ideal) {
+  std::vector<operation> body, tail;
+  bool moved = false;
+  for (auto op : operations) {
+    if (op.id == gate_t::Measure && op.if_op == false) {
+      tail.push_back(op);
+      continue;
+    }
+    if (tail.empty()) {
+      body.push_back(op);
+      continue;
+    }
+    // Conditional operations must not depend on deferred measurements
+    if (op.if_op) {
+      bool depends = false;
+      for (const auto &meas : tail)
+        depends |= (meas.clbits[0] < op.cond.mask.size() &&
+                    op.cond.mask[meas.clbits[0]] == 1);
+      if (depends && !(ideal && defer_conditional(op, tail, gs)))
+        return false;
+    }
+    // Check operation commutes with all deferred measurements
+    for (const auto &meas : tail)
+      if (commutes_with_measure(op, meas.qubits[0], ideal) == false)
+        return false;
+    body.push_back(op);
+    moved = true;
+  }
+  if (moved) {
+    body.insert(body.end(), tail.begin(), tail.end());
+    operations = body;
+  }
+  return moved;
+}
+
+bool Circuit::commutes_with_measure(const operation &op, uint_t qubit,
+                                    bool ideal) const {
+  switch (op.id) {
+  case gate_t::Barrier:
+    return true;
+  case gate_t::Save:
+  case gate_t::Load:
+    return false;
+  case gate_t::Noise:
+    return ideal;
+  default:
+    break;
+  }
+  auto pos = std::find(op.qubits.cbegin(), op.qubits.cend(), qubit);
+  if (pos == op.qubits.cend())
+    return true;
+  // Noisy gates may not commute even if the ideal gate does
+  if (ideal == false)
+    return false;
+  switch (op.id) {
+  case gate_t::I:
+  case gate_t::U0: // u0 = id without noise
+  case gate_t::Wait:
+  case gate_t::Z:
+  case gate_t::S:
+  case gate_t::Sd:
+  case gate_t::T:
+  case gate_t::Td:
+  case gate_t::U1:
+  case gate_t::CZ:
+  case gate_t::UZZ:
+    return true;
+  case gate_t::CX: // diagonal on the control qubit only
+    return pos == op.qubits.cbegin();
+  default:
+    return false;
+  }
+}
+
+bool Circuit::defer_conditional(operation &op,
+                                const std::vector<operation> &tail,
+                                const gateset_t &gs) {
+  if (op.cond.type != "equals" || op.cond.val.size() != 1 ||
+      op.cond.val[0] != 1 || op.qubits.size() != 1)
+    return false;
+  const uint_t clbit = op.cond.mask.size() - 1; // mask is trimmed at last 1
+  // Find the last measurement recorded in the condition clbit
+  auto meas = std::find_if(
+      tail.crbegin(), tail.crend(),
+      [clbit](const operation &m) { return m.clbits[0] == clbit; });
+  if (meas == tail.crend() || meas->qubits[0] == op.qubits[0])
+    return false;
+  operation cop;
+  if ((op.id == gate_t::X && set_gateid(cop, "cx", gs)) ||
+      (op.id == gate_t::Z && set_gateid(cop, "cz", gs))) {
+    cop.qubits = {meas->qubits[0], op.qubits[0]};
+    op = cop;
+    return true;
+  }
+  return false;
+}
+
 //------------------------------------------------------------------------------
 } // end namespace QISKIT
 #endif
@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    lru_cache.hpp
+ * @brief   Thread-safe least recently used cache
+ */
+
+#ifndef _lru_cache_h_
+#define _lru_cache_h_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "types.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * LRUCache class
+  *
+  * A thread-safe cache of values keyed by a hash, such as backend states keyed
+  * by the hash of the circuit operations that produced them. When the cache is
+  * full the least recently used value is evicted. Values are shared as
+  * pointers to const so a lookup does not copy them while holding the lock.
+  *
+  ******************************************************************************/
+
+template <typename T> class LRUCache {
+public:
+  /**
+   * Constructs a cache holding at most capacity values.
+   */
+  explicit LRUCache(uint_t capacity = 1) : capacity_(capacity){};
+
+  /**
+   * Looks up a value and marks it as most recently used.
+   * @param key: the hash of the value.
+   * @returns: the value, or nullptr if it is not in the cache.
+   */
+  std::shared_ptr<const T> find(uint_t key);
+
+  /**
+   * Inserts a value, evicting the least recently used value if the cache is
+   * full. An existing value with the same key is replaced.
+   * @param key: the hash of the value.
+   * @param value: the value.
+   */
+  void insert(uint_t key, T value);
+
+  // Removes all values
+  void clear();
+
+  // Returns the number of cached values
+  uint_t size();
+
+  // Returns the maximum number of cached values
+  uint_t capacity() const { return capacity_; };
+
+private:
+  using entry_t = std::pair<uint_t, std::shared_ptr<const T>>;
+  uint_t capacity_;
+  std::list<entry_t> entries_; // most recently used first
+  std::unordered_map<uint_t, typename std::list<entry_t>::iterator> index_;
+  std::mutex mutex_;
+};
+
+/*******************************************************************************
+ *
+ * LRUCache methods
+ *
+ ******************************************************************************/
+
+template <typename T>
+std::shared_ptr<const T> LRUCache<T>::find(uint_t key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end())
+    return nullptr;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+template <typename T> void LRUCache<T>::insert(uint_t key, T value) {
+  auto ptr = std::make_shared<const T>(std::move(value));
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (capacity_ == 0)
+    return;
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    it->second->second = ptr;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+  if (entries_.size() >= capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.emplace_front(key, ptr);
+  index_[key] = entries_.begin();
+}
+
+template <typename T> void LRUCache<T>::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+}
+
+template <typename T> uint_t LRUCache<T>::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+
+#endif
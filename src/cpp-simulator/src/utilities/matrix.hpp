@@ -130,6 +130,11 @@ void zgemm_(const char *TransA, const char *TransB, const size_t *M,
             const std::complex<double> *B, const size_t *ldb,
             const std::complex<double> *beta, std::complex<double> *C,
             size_t *ldc);
+// Double-Precison Complex Hermitian Rank-K Update
+void zherk_(const char *Uplo, const char *Trans, const size_t *N,
+            const size_t *K, const double *alpha,
+            const std::complex<double> *A, const size_t *lda,
+            const double *beta, std::complex<double> *C, const size_t *ldc);
 #ifdef __cplusplus
 }
 #endif
@@ -215,6 +220,7 @@ public:
                        // sqrt(dims)
   matrix(const matrix<T> &m);
   matrix(const matrix<T> &m, const char uplo);
+  matrix(matrix<T> &&m) noexcept;
 
   // Initialize an empty matrix() to matrix(size_t  rows, size_t cols)
   void initialize(size_t rows, size_t cols);
@@ -226,6 +232,7 @@ public:
 
   // Assignment operator
   matrix<T> &operator=(const matrix<T> &m);
+  matrix<T> &operator=(matrix<T> &&m) noexcept;
   template <class S>
   matrix<T> &operator=(const matrix<S> &m); // Still would like to have real
                                             // assigend by complex -- take real
@@ -563,6 +570,14 @@ inline matrix<T>::matrix(const matrix<T> &rhs)
   }
 }
 template <class T>
+inline matrix<T>::matrix(matrix<T> &&rhs) noexcept
+    : rows_(rhs.rows_), cols_(rhs.cols_), size_(rhs.size_), LD_(rhs.LD_),
+      outputstyle_(rhs.outputstyle_), mat_(rhs.mat_) {
+  // Move constructor, takes the memory of rhs and leaves it empty
+  rhs.rows_ = rhs.cols_ = rhs.size_ = rhs.LD_ = 0;
+  rhs.mat_ = 0;
+}
+template <class T>
 inline matrix<T>::matrix(const matrix<T> &rhs, const char uplo)
     : rows_(rhs.rows_), cols_(rhs.cols_), size_(rhs.size_), LD_(rows_),
       outputstyle_(rhs.outputstyle_), mat_(new T[size_]) {
@@ -628,6 +643,17 @@ template <class T> inline matrix<T>::~matrix() {
     delete[](mat_);
 }
 template <class T>
+inline matrix<T> &matrix<T>::operator=(matrix<T> &&rhs) noexcept {
+  // Move assignment, swaps the memory of the two matrices
+  std::swap(rows_, rhs.rows_);
+  std::swap(cols_, rhs.cols_);
+  std::swap(size_, rhs.size_);
+  std::swap(LD_, rhs.LD_);
+  std::swap(outputstyle_, rhs.outputstyle_);
+  std::swap(mat_, rhs.mat_);
+  return *this;
+}
+template <class T>
 inline matrix<T> &matrix<T>::operator=(const matrix<T> &rhs) {
   // overloading the assignement operator
   // postcondition: normal assignment via copying has been performed;
@@ -28,6 +28,7 @@ limitations under the License.
 #include <complex>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -87,6 +88,20 @@ std::string read_stream(std::istream &input);
 std::vector<std::string> read_stream(std::istream &input,
                                      std::string file_break);
 
+//------------------------------------------------------------------------------
+// Hashing
+//------------------------------------------------------------------------------
+
+/**
+ * Computes the 64-bit FNV-1a hash of a block of memory.
+ * @param data: pointer to the first byte
+ * @param len: the number of bytes to hash
+ * @param hash: the hash to continue from, or the FNV offset basis
+ * @return: the updated hash value
+ */
+uint_t fnv1a_hash(const void *data, size_t len,
+                  uint_t hash = 14695981039346656037ULL);
+
 //------------------------------------------------------------------------------
 // Map overloads
 //------------------------------------------------------------------------------
@@ -123,6 +138,15 @@ rvector_t operator*(const rvector_t &v1, const double a);
 rvector_t operator*(const double a, const rvector_t &v1);
 cvector_t operator*(const cvector_t &v1, const complex_t z);
 cvector_t operator*(const complex_t z, const cvector_t &v1);
+/**
+ * Appends the elements of a vector to another by moving them. If the
+ * destination is empty the source buffer is taken instead.
+ * @param dest: the vector to append to
+ * @param src: the vector to append, which is left empty
+ */
+template <typename T>
+void move_append(std::vector<T> &dest, std::vector<T> &src);
+
 /**
  * Computes the inner product (v1^*.v2) between two numeric vectors.
  * @param v1: the lhs vector (complex conjugated)
@@ -393,6 +417,19 @@ std::vector<std::string> read_stream(std::istream &input,
   return files;
 }
 
+//------------------------------------------------------------------------------
+// Hashing
+//------------------------------------------------------------------------------
+
+uint_t fnv1a_hash(const void *data, size_t len, uint_t hash) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t j = 0; j < len; j++) {
+    hash ^= bytes[j];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
 //------------------------------------------------------------------------------
 // Map overloads
 //------------------------------------------------------------------------------
@@ -551,6 +588,16 @@ rvector_t operator*(const double a, const rvector_t &v1) { return v1 * a; }
 
 cvector_t operator*(const complex_t z, const cvector_t &v1) { return v1 * z; }
 
+template <typename T>
+void move_append(std::vector<T> &dest, std::vector<T> &src) {
+  if (dest.empty())
+    dest.swap(src);
+  else
+    dest.insert(dest.end(), std::make_move_iterator(src.begin()),
+                std::make_move_iterator(src.end()));
+  src.clear();
+}
+
 template <typename T>
 std::complex<T> inner_product(const std::vector<std::complex<T>> &v1,
                               const std::vector<std::complex<T>> &v2) {
@@ -0,0 +1,213 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    npy.hpp
+ * @brief   Binary output of arrays in the numpy .npy file format
+ */
+
+#ifndef _npy_h_
+#define _npy_h_
+
+#include <complex>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+/***************************************************************************/ /**
+  *
+  * NPY File Helper Functions
+  *
+  * Arrays are written as version 1.0 .npy files of little-endian float64 or
+  * complex128 values, which numpy can memory map with np.load(file,
+  * mmap_mode='r'). Each save function returns a JSON reference to the file of
+  * the form {"file": name, "dtype": dtype, "shape": [dims...]}.
+  *
+  ******************************************************************************/
+
+namespace NPY {
+
+/**
+ * Write a contiguous array to a .npy file.
+ * @param file: the file name to write.
+ * @param data: pointer to the first array element.
+ * @param shape: the array dimensions.
+ * @param fortran_order: true if the array is stored in column-major order.
+ * @returns: the JSON reference to the file.
+ */
+template <typename T>
+json_t save(const std::string &file, const T *data,
+            const std::vector<uint_t> &shape, bool fortran_order = false);
+
+/**
+ * Write a vector as a 1D array to a .npy file.
+ */
+template <typename T>
+json_t save(const std::string &file, const std::vector<T> &vec);
+
+/**
+ * Write rows of equal length as a 2D array to a .npy file.
+ * @param file: the file name to write.
+ * @param rows: pointers to the first element of each row.
+ * @param cols: the length of the rows.
+ * @returns: the JSON reference to the file.
+ */
+template <typename T>
+json_t save(const std::string &file, const std::vector<const T *> &rows,
+            uint_t cols);
+
+/**
+ * Write a list of equal length vectors as the rows of a 2D array to a .npy
+ * file.
+ */
+template <typename T>
+json_t save(const std::string &file, const std::vector<std::vector<T>> &vecs);
+
+/**
+ * Write a matrix to a .npy file. The matrix is written in its column-major
+ * storage order.
+ */
+template <typename T>
+json_t save(const std::string &file, const matrix<T> &mat);
+
+/**
+ * Create a .npy file and write the header for an array.
+ * @param file: the file name to write.
+ * @param descr: the numpy dtype descriptor of the array elements.
+ * @param shape: the array dimensions.
+ * @param fortran_order: true if the array is stored in column-major order.
+ * @returns: the output stream positioned at the start of the array data.
+ */
+std::ofstream create(const std::string &file, const char *descr,
+                     const std::vector<uint_t> &shape, bool fortran_order);
+
+// Numpy dtype names for the supported element types
+template <typename T> struct dtype;
+template <> struct dtype<double> {
+  static const char *descr() { return "<f8"; }
+  static const char *name() { return "float64"; }
+};
+template <> struct dtype<std::complex<double>> {
+  static const char *descr() { return "<c16"; }
+  static const char *name() { return "complex128"; }
+};
+
+} // end namespace NPY
+
+/*******************************************************************************
+ *
+ * Implementations
+ *
+ ******************************************************************************/
+
+namespace NPY {
+
+std::ofstream create(const std::string &file, const char *descr,
+                     const std::vector<uint_t> &shape, bool fortran_order) {
+  const uint16_t probe = 1;
+  if (*reinterpret_cast<const uint8_t *>(&probe) != 1)
+    throw std::runtime_error("binary output requires a little-endian host");
+
+  std::stringstream ss;
+  ss << "{'descr': '" << descr << "', 'fortran_order': "
+     << (fortran_order ? "True" : "False") << ", 'shape': (";
+  for (const auto &dim : shape)
+    ss << dim << ", ";
+  ss << "), }";
+  // pad header with spaces so the data is 64 byte aligned
+  std::string header = ss.str();
+  const uint_t preamble = 10; // magic string, version and header length
+  header.append(63 - (preamble + header.size()) % 64, ' ');
+  header.push_back('\n');
+
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  if (out.is_open() == false)
+    throw std::runtime_error("unable to open binary output file \"" + file +
+                             "\"");
+  const uint16_t len = static_cast<uint16_t>(header.size());
+  out.write("\x93NUMPY\x01\x00", 8);
+  out.put(static_cast<char>(len & 0xff));
+  out.put(static_cast<char>(len >> 8));
+  out.write(header.data(), header.size());
+  return out;
+}
+
+template <typename T>
+json_t save(const std::string &file, const T *data,
+            const std::vector<uint_t> &shape, bool fortran_order) {
+  uint_t size = 1;
+  for (const auto &dim : shape)
+    size *= dim;
+  std::ofstream out = create(file, dtype<T>::descr(), shape, fortran_order);
+  out.write(reinterpret_cast<const char *>(data), size * sizeof(T));
+  if (out.good() == false)
+    throw std::runtime_error("failed to write binary output file \"" + file +
+                             "\"");
+  json_t js;
+  js["file"] = file;
+  js["dtype"] = dtype<T>::name();
+  js["shape"] = shape;
+  return js;
+}
+
+template <typename T>
+json_t save(const std::string &file, const std::vector<T> &vec) {
+  return save(file, vec.data(), {vec.size()});
+}
+
+template <typename T>
+json_t save(const std::string &file, const std::vector<const T *> &rows,
+            uint_t cols) {
+  std::ofstream out =
+      create(file, dtype<T>::descr(), {rows.size(), cols}, false);
+  for (const auto &row : rows)
+    out.write(reinterpret_cast<const char *>(row), cols * sizeof(T));
+  if (out.good() == false)
+    throw std::runtime_error("failed to write binary output file \"" + file +
+                             "\"");
+  json_t js;
+  js["file"] = file;
+  js["dtype"] = dtype<T>::name();
+  js["shape"] = {rows.size(), cols};
+  return js;
+}
+
+template <typename T>
+json_t save(const std::string &file, const std::vector<std::vector<T>> &vecs) {
+  const uint_t cols = vecs.empty() ? 0 : vecs[0].size();
+  std::vector<const T *> rows;
+  for (const auto &vec : vecs) {
+    if (vec.size() != cols)
+      throw std::runtime_error("binary output rows have different lengths");
+    rows.push_back(vec.data());
+  }
+  return save(file, rows, cols);
+}
+
+template <typename T>
+json_t save(const std::string &file, const matrix<T> &mat) {
+  return save(file, mat.GetMat(), {mat.GetRows(), mat.GetColumns()}, true);
+}
+
+} // end namespace NPY
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,358 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    pauli_observable.hpp
+ * @brief   Observables given by weighted sums of Pauli operators
+ */
+
+#ifndef _pauli_observable_h_
+#define _pauli_observable_h_
+
+#include <bitset>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * PauliTerm struct
+  *
+  * A single Pauli operator coeff * P_{n-1} ... P_1 P_0 stored as bit-masks.
+  * Acting on a basis state |i> it gives coeff * (i)^num_y *
+  * (-1)^popcount(i & z_mask) |i ^ x_mask>.
+  *
+  ******************************************************************************/
+
+struct PauliTerm {
+  double coeff = 1.;
+  uint_t x_mask = 0; // qubits acted on by X or Y
+  uint_t z_mask = 0; // qubits acted on by Z or Y
+  uint_t num_y = 0;  // number of Y factors
+  std::string label; // Pauli string label
+};
+
+/***************************************************************************/ /**
+  *
+  * PauliGroup struct
+  *
+  * A set of qubit-wise commuting Pauli terms. On each qubit every term in the
+  * group acts either as the identity or as the Pauli given by the group basis
+  * masks, so all terms are diagonalized by a single basis rotation.
+  *
+  ******************************************************************************/
+
+struct PauliGroup {
+  uint_t x_mask = 0;         // qubits measured in the X or Y basis
+  uint_t z_mask = 0;         // qubits measured in the Z or Y basis
+  std::vector<uint_t> terms; // indices of the terms in the group
+};
+
+/***************************************************************************/ /**
+  *
+  * PauliObservable class
+  *
+  * A Hermitian observable given as a real weighted sum of Pauli operators.
+  * Each term is specified by a Pauli string of the characters I, X, Y, Z where
+  * the rightmost character acts on qubit 0.
+  *
+  * Terms are greedily partitioned into groups of qubit-wise commuting terms as
+  * they are added. The expectation value of a group with more than one term is
+  * computed by rotating a copy of the state into the group basis once, and
+  * evaluating every term as a diagonal Z-string in a single sweep over the
+  * rotated amplitudes.
+  *
+  ******************************************************************************/
+
+class PauliObservable {
+public:
+  std::vector<PauliTerm> terms;
+  std::vector<PauliGroup> groups;
+
+  /**
+   * Add a term to the observable.
+   * @param coeff: the real coefficient of the term.
+   * @param label: the Pauli string of the term.
+   */
+  void add_term(double coeff, const std::string &label);
+
+  /**
+   * Compute the expectation value <psi|O|psi> of the observable for a
+   * state vector.
+   * @param psi: the state vector.
+   * @param nthreads: number of threads for the sum over amplitudes.
+   * @returns: the real expectation value.
+   */
+  double expectation_value(const cvector_t &psi, uint_t nthreads = 1) const;
+
+  /**
+   * Compute the expectation value <psi|P|psi> of a single Pauli term without
+   * its coefficient.
+   */
+  static double expectation_value(const PauliTerm &term, const cvector_t &psi,
+                                  uint_t nthreads = 1);
+
+  /**
+   * Compute the weighted sum of the expectation values of the terms in a
+   * group by a single basis rotation of a copy of the state.
+   */
+  double expectation_value(const PauliGroup &group, const cvector_t &psi,
+                           uint_t nthreads = 1) const;
+
+  /**
+   * Apply the observable to a state vector.
+   * @param psi: the state vector.
+   * @param nthreads: number of threads for the loop over amplitudes.
+   * @returns: the vector O|psi>.
+   */
+  cvector_t apply(const cvector_t &psi, uint_t nthreads = 1) const;
+
+private:
+  // Add a term index to the first group it qubit-wise commutes with
+  void add_to_group(uint_t pos);
+};
+
+/*******************************************************************************
+ *
+ * PauliObservable methods
+ *
+ ******************************************************************************/
+
+void PauliObservable::add_term(double coeff, const std::string &label) {
+  if (label.size() > 64)
+    throw std::runtime_error("Pauli observable \"" + label +
+                             "\" acts on more than 64 qubits");
+  PauliTerm term;
+  term.coeff = coeff;
+  term.label = label;
+  const uint_t n = label.size();
+  for (uint_t j = 0; j < n; j++) {
+    const uint_t bit = 1ULL << j;
+    switch (label[n - 1 - j]) {
+    case 'I':
+      break;
+    case 'X':
+      term.x_mask |= bit;
+      break;
+    case 'Y':
+      term.x_mask |= bit;
+      term.z_mask |= bit;
+      term.num_y++;
+      break;
+    case 'Z':
+      term.z_mask |= bit;
+      break;
+    default:
+      throw std::runtime_error("invalid Pauli observable \"" + label + "\"");
+    }
+  }
+  terms.push_back(term);
+  add_to_group(terms.size() - 1);
+}
+
+void PauliObservable::add_to_group(uint_t pos) {
+  const PauliTerm &term = terms[pos];
+  const uint_t support = term.x_mask | term.z_mask;
+  for (auto &group : groups) {
+    // the term and group must agree on the qubits they both act on
+    const uint_t common = support & (group.x_mask | group.z_mask);
+    if ((((term.x_mask ^ group.x_mask) | (term.z_mask ^ group.z_mask)) &
+         common) == 0) {
+      group.x_mask |= term.x_mask;
+      group.z_mask |= term.z_mask;
+      group.terms.push_back(pos);
+      return;
+    }
+  }
+  PauliGroup group;
+  group.x_mask = term.x_mask;
+  group.z_mask = term.z_mask;
+  group.terms.push_back(pos);
+  groups.push_back(group);
+}
+
+double PauliObservable::expectation_value(const PauliTerm &term,
+                                          const cvector_t &psi,
+                                          uint_t nthreads) {
+  const uint_t dim = psi.size();
+  const uint_t x_mask = term.x_mask;
+  const uint_t z_mask = term.z_mask;
+  if ((x_mask | z_mask) >= dim) {
+    std::stringstream msg;
+    msg << "Pauli observable \"" << term.label << "\" acts on more qubits"
+        << " than the state vector of dimension " << dim;
+    throw std::runtime_error(msg.str());
+  }
+  double re = 0., im = 0.;
+#pragma omp parallel for reduction(+ : re, im) if (nthreads > 1)               \
+    num_threads(nthreads)
+  for (uint_t k = 0; k < dim; k++) {
+    const complex_t val = std::conj(psi[k ^ x_mask]) * psi[k];
+    if (std::bitset<64>(k & z_mask).count() & 1) {
+      re -= std::real(val);
+      im -= std::imag(val);
+    } else {
+      re += std::real(val);
+      im += std::imag(val);
+    }
+  }
+  // multiply by i^num_y and take the real part
+  switch (term.num_y & 3) {
+  case 0:
+    return re;
+  case 1:
+    return -im;
+  case 2:
+    return -re;
+  default:
+    return im;
+  }
+}
+
+double PauliObservable::expectation_value(const PauliGroup &group,
+                                          const cvector_t &psi,
+                                          uint_t nthreads) const {
+  const uint_t dim = psi.size();
+  if ((group.x_mask | group.z_mask) >= dim) {
+    std::stringstream msg;
+    msg << "Pauli observable acts on more qubits than the state vector of"
+        << " dimension " << dim;
+    throw std::runtime_error(msg.str());
+  }
+
+  // Rotate a copy of the state so that each X or Y qubit of the group basis is
+  // measured in the Z basis. This applies H for X and H.Sdg for Y.
+  cvector_t phi(psi);
+  const double isqrt2 = 1. / std::sqrt(2.);
+  const complex_t phase_y(0., -1.);
+  for (uint_t q = 0; (group.x_mask >> q) != 0; q++) {
+    const uint_t bit = 1ULL << q;
+    if ((group.x_mask & bit) == 0)
+      continue;
+    const complex_t phase = (group.z_mask & bit) ? phase_y : complex_t(1.);
+    const uint_t step = bit << 1;
+#pragma omp parallel for collapse(2) if (nthreads > 1) num_threads(nthreads)
+    for (uint_t k1 = 0; k1 < dim; k1 += step)
+      for (uint_t k2 = 0; k2 < bit; k2++) {
+        const uint_t k = k1 | k2;
+        const complex_t cache0 = phi[k];
+        const complex_t cache1 = phase * phi[k | bit];
+        phi[k] = isqrt2 * (cache0 + cache1);
+        phi[k | bit] = isqrt2 * (cache0 - cache1);
+      }
+  }
+
+  // Each term is now a Z-string on its support
+  const uint_t nterms = group.terms.size();
+  std::vector<uint_t> masks;
+  for (const auto &pos : group.terms)
+    masks.push_back(terms[pos].x_mask | terms[pos].z_mask);
+
+  rvector_t vals(nterms, 0.);
+#pragma omp parallel if (nthreads > 1) num_threads(nthreads)
+  {
+    rvector_t local(nterms, 0.);
+#pragma omp for
+    for (uint_t k = 0; k < dim; k++) {
+      const double p = std::norm(phi[k]);
+      for (uint_t t = 0; t < nterms; t++)
+        local[t] += (std::bitset<64>(k & masks[t]).count() & 1) ? -p : p;
+    }
+#pragma omp critical
+    for (uint_t t = 0; t < nterms; t++)
+      vals[t] += local[t];
+  }
+
+  double val = 0.;
+  for (uint_t t = 0; t < nterms; t++)
+    val += terms[group.terms[t]].coeff * vals[t];
+  return val;
+}
+
+cvector_t PauliObservable::apply(const cvector_t &psi, uint_t nthreads) const {
+  const uint_t dim = psi.size();
+  cvector_t ret(dim, 0.);
+  const complex_t phases[4] = {1., complex_t(0., 1.), -1., complex_t(0., -1.)};
+  for (const auto &term : terms) {
+    const uint_t x_mask = term.x_mask;
+    const uint_t z_mask = term.z_mask;
+    if ((x_mask | z_mask) >= dim) {
+      std::stringstream msg;
+      msg << "Pauli observable \"" << term.label << "\" acts on more qubits"
+          << " than the state vector of dimension " << dim;
+      throw std::runtime_error(msg.str());
+    }
+    const complex_t coeff = term.coeff * phases[term.num_y & 3];
+#pragma omp parallel for if (nthreads > 1) num_threads(nthreads)
+    for (uint_t j = 0; j < dim; j++) {
+      const uint_t k = j ^ x_mask;
+      if (std::bitset<64>(k & z_mask).count() & 1)
+        ret[j] -= coeff * psi[k];
+      else
+        ret[j] += coeff * psi[k];
+    }
+  }
+  return ret;
+}
+
+double PauliObservable::expectation_value(const cvector_t &psi,
+                                          uint_t nthreads) const {
+  double val = 0.;
+  for (const auto &group : groups) {
+    if (group.terms.size() == 1) {
+      // a single term is cheaper to evaluate without a basis rotation
+      const PauliTerm &term = terms[group.terms[0]];
+      val += term.coeff * expectation_value(term, psi, nthreads);
+    } else
+      val += expectation_value(group, psi, nthreads);
+  }
+  return val;
+}
+
+/*******************************************************************************
+ *
+ * JSON conversion
+ *
+ ******************************************************************************/
+
+/**
+ * An observable is specified by a list of terms of the form
+ * {"coeff": 0.5, "pauli": "XZ"}
+ */
+inline void from_json(const json_t &js, PauliObservable &obs) {
+  obs = PauliObservable();
+  if (js.is_array() == false)
+    throw std::runtime_error("Pauli observable must be a list of terms");
+  for (const auto &term : js) {
+    double coeff = 1.;
+    std::string label;
+    JSON::get_value(coeff, "coeff", term);
+    if (JSON::get_value(label, "pauli", term) == false)
+      throw std::runtime_error("Pauli observable term is missing \"pauli\"");
+    obs.add_term(coeff, label);
+  }
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+
+#endif
@@ -0,0 +1,177 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    result_cache.hpp
+ * @brief   On-disk cache of circuit results
+ */
+
+#ifndef _result_cache_h_
+#define _result_cache_h_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "types.hpp"
+
+namespace QISKIT {
+
+/***************************************************************************/ /**
+  *
+  * ResultCache class
+  *
+  * A directory of circuit results stored as JSON files named by a content
+  * hash of the circuit. A lookup updates the modification time of the file,
+  * and when the total size of the directory exceeds its limit the files with
+  * the oldest modification times are removed. Files are written to a
+  * temporary name and renamed, so several processes may share a directory.
+  *
+  ******************************************************************************/
+
+class ResultCache {
+public:
+  /**
+   * Opens a cache directory, creating it if needed.
+   * @param dir: the cache directory.
+   * @param max_bytes: the maximum total size of the cached results.
+   */
+  ResultCache(std::string dir, uint_t max_bytes);
+
+  /**
+   * Looks up a result.
+   * @param key: the content hash of the circuit.
+   * @param result: set to the cached result if found.
+   * @returns: true if the result was found.
+   */
+  bool find(const std::string &key, json_t &result) const;
+
+  /**
+   * Stores a result and evicts the least recently used results if the cache
+   * exceeds its size limit.
+   * @param key: the content hash of the circuit.
+   * @param result: the circuit result.
+   */
+  void insert(const std::string &key, const json_t &result) const;
+
+private:
+  std::string dir_;
+  uint_t max_bytes_;
+
+  std::string path(const std::string &key) const {
+    return dir_ + "/" + key + ".json";
+  };
+
+  // Removes the oldest results until the cache is within its size limit
+  void evict() const;
+};
+
+/*******************************************************************************
+ *
+ * ResultCache methods
+ *
+ ******************************************************************************/
+
+ResultCache::ResultCache(std::string dir, uint_t max_bytes)
+    : dir_(std::move(dir)), max_bytes_(max_bytes) {
+  if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST)
+    throw std::runtime_error("unable to create result cache directory \"" +
+                             dir_ + "\"");
+}
+
+bool ResultCache::find(const std::string &key, json_t &result) const {
+  const std::string file = path(key);
+  std::ifstream in(file);
+  if (in.is_open() == false)
+    return false;
+  try {
+    in >> result;
+  } catch (std::exception &) {
+    return false; // partially evicted or corrupt entries are misses
+  }
+  utimes(file.c_str(), nullptr); // mark as recently used
+  return true;
+}
+
+void ResultCache::insert(const std::string &key, const json_t &result) const {
+  const std::string file = path(key);
+  std::stringstream tmp;
+  tmp << file << ".tmp" << getpid() << "_"
+      << std::hash<std::thread::id>()(std::this_thread::get_id());
+  {
+    std::ofstream out(tmp.str());
+    if (out.is_open() == false)
+      return; // caching is best effort
+    out << result.dump();
+    if (out.good() == false) {
+      out.close();
+      std::remove(tmp.str().c_str());
+      return;
+    }
+  }
+  std::rename(tmp.str().c_str(), file.c_str());
+  evict();
+}
+
+void ResultCache::evict() const {
+  DIR *dir = opendir(dir_.c_str());
+  if (dir == nullptr)
+    return;
+  std::vector<std::pair<time_t, std::pair<std::string, uint_t>>> files;
+  uint_t total = 0;
+  const std::string ext = ".json";
+  for (dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name.size() <= ext.size() ||
+        name.compare(name.size() - ext.size(), ext.size(), ext) != 0)
+      continue;
+    struct stat info;
+    const std::string file = dir_ + "/" + name;
+    if (stat(file.c_str(), &info) != 0)
+      continue;
+    const uint_t size = static_cast<uint_t>(info.st_size);
+    files.push_back(std::make_pair(info.st_mtime, std::make_pair(file, size)));
+    total += size;
+  }
+  closedir(dir);
+  if (total <= max_bytes_)
+    return;
+  std::sort(files.begin(), files.end());
+  for (const auto &f : files) {
+    if (total <= max_bytes_)
+      break;
+    if (std::remove(f.second.first.c_str()) == 0)
+      total -= f.second.second;
+  }
+}
+
+//------------------------------------------------------------------------------
+} // end namespace QISKIT
+
+#endif
@@ -0,0 +1,147 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    shm.hpp
+ * @brief   Export of arrays to POSIX shared memory segments
+ */
+
+#ifndef _shm_h_
+#define _shm_h_
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "npy.hpp"
+#include "types.hpp"
+
+/***************************************************************************/ /**
+  *
+  * Shared Memory Helper Functions
+  *
+  * Arrays are copied in row-major order into a named POSIX shared memory
+  * segment created with shm_open. This is not zero-copy: the simulator keeps
+  * its own copy of the array until the segment is written, so both are held
+  * in memory at once. It only avoids encoding the values as JSON or .npy
+  * files, and the caller maps the segment without parsing it. The segment
+  * holds only the raw little-endian values. Each save function returns a JSON
+  * reference to the segment of the form {"shm": name, "dtype": dtype,
+  * "shape": [dims...]}. Segments are not removed by the simulator, so the
+  * caller must shm_unlink them.
+  *
+  ******************************************************************************/
+
+namespace SHM {
+
+/**
+ * Write rows of equal length as a 2D array to a shared memory segment,
+ * replacing any segment of the same name.
+ * @param name: the segment name, which is prefixed by '/' if needed.
+ * @param rows: pointers to the first element of each row.
+ * @param cols: the length of the rows.
+ * @returns: the JSON reference to the segment.
+ */
+template <typename T>
+json_t save(std::string name, const std::vector<const T *> &rows,
+            uint_t cols);
+
+/**
+ * Write a list of equal length vectors as the rows of a 2D array to a shared
+ * memory segment.
+ */
+template <typename T>
+json_t save(const std::string &name, const std::vector<std::vector<T>> &vecs);
+
+} // end namespace SHM
+
+/*******************************************************************************
+ *
+ * Implementations
+ *
+ ******************************************************************************/
+
+namespace SHM {
+
+template <typename T>
+json_t save(std::string name, const std::vector<const T *> &rows,
+            uint_t cols) {
+  const uint16_t probe = 1;
+  if (*reinterpret_cast<const uint8_t *>(&probe) != 1)
+    throw std::runtime_error("shared memory output requires a little-endian "
+                             "host");
+  if (name.empty() || name[0] != '/')
+    name.insert(name.begin(), '/');
+
+  const size_t bytes = rows.size() * cols * sizeof(T);
+
+  const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+  if (fd < 0)
+    throw std::runtime_error("unable to create shared memory segment \"" +
+                             name + "\": " + std::strerror(errno));
+  void *data = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(bytes)) == 0 && bytes > 0)
+    data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const std::string err = std::strerror(errno);
+  close(fd);
+  if (bytes > 0 && data == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("unable to map shared memory segment \"" + name +
+                             "\": " + err);
+  }
+
+  // Rows are copied in parallel as they may be very large
+  T *dest = static_cast<T *>(data);
+  for (uint_t r = 0; r < rows.size(); r++) {
+    const T *src = rows[r];
+    T *row = dest + r * cols;
+#pragma omp parallel for if (cols > (1ULL << 20))
+    for (int_t k = 0; k < static_cast<int_t>(cols); k++)
+      row[k] = src[k];
+  }
+  if (bytes > 0)
+    munmap(data, bytes);
+
+  json_t js;
+  js["shm"] = name;
+  js["dtype"] = NPY::dtype<T>::name();
+  js["shape"] = {rows.size(), cols};
+  return js;
+}
+
+template <typename T>
+json_t save(const std::string &name, const std::vector<std::vector<T>> &vecs) {
+  const uint_t cols = vecs.empty() ? 0 : vecs[0].size();
+  std::vector<const T *> rows;
+  for (const auto &vec : vecs) {
+    if (vec.size() != cols)
+      throw std::runtime_error("shared memory output rows have different "
+                               "lengths");
+    rows.push_back(vec.data());
+  }
+  return save(name, rows, cols);
+}
+
+} // end namespace SHM
+
+//------------------------------------------------------------------------------
+#endif
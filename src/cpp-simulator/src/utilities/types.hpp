@@ -30,6 +30,7 @@ limitations under the License.
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <set>
 #include <vector>
 
 #include "binary_vector.hpp" // Binary Vector class
@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2017 IBM Corporation. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * @file    capi_test.c
+ * @brief   Smoke test of the C API of the libqiskit_simulator shared library
+ *
+ * Built and run by "make test_capi" in src. Exits with a nonzero status if
+ * any check fails.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "qiskit_simulator.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,        \
+              #cond);                                                          \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+/* Runs a GHZ state circuit on a simulator and checks its counts and state */
+static void test_ghz(const char *simulator) {
+  const uint64_t q0[] = {0}, q1[] = {1}, q2[] = {2};
+  const uint64_t q01[] = {0, 1}, q12[] = {1, 2};
+  const uint64_t c0[] = {0}, c1[] = {1}, c2[] = {2};
+  const qiskit_operation ops[] = {
+      {"h", q0, 1, NULL, 0, NULL, 0, 0, 0},
+      {"cx", q01, 2, NULL, 0, NULL, 0, 0, 0},
+      {"cx", q12, 2, NULL, 0, NULL, 0, 0, 0},
+      {"measure", q0, 1, c0, 1, NULL, 0, 0, 0},
+      {"measure", q1, 1, c1, 1, NULL, 0, 0, 0},
+      {"measure", q2, 1, c2, 1, NULL, 0, 0, 0}};
+  qiskit_circuit *circ = qiskit_circuit_create(3, 3, ops, 6);
+  CHECK(circ != NULL);
+
+  qiskit_config config;
+  qiskit_config_init(&config);
+  config.simulator = simulator;
+  config.shots = 1000;
+  config.seed = 7;
+  config.quantum_state = 1;
+  qiskit_result *res = qiskit_run(circ, &config);
+  CHECK(res != NULL);
+  CHECK(qiskit_result_success(res));
+  CHECK(strcmp(qiskit_result_status(res), "DONE") == 0);
+
+  uint64_t outcomes[8], counts[8], total = 0, j;
+  const uint64_t n = qiskit_result_counts(res, outcomes, counts, 8);
+  CHECK(n == 2 && n == qiskit_result_num_outcomes(res));
+  for (j = 0; j < n; j++) {
+    CHECK(outcomes[j] == 0 || outcomes[j] == 7);
+    total += counts[j];
+  }
+  CHECK(total == 1000);
+
+  /* The state after the measurements is |000> or |111> */
+  double amps[16], norm = 0.;
+  if (strcmp(simulator, "clifford") == 0)
+    CHECK(qiskit_result_state_size(res) == 0);
+  else {
+    CHECK(qiskit_result_state_size(res) == 8);
+    CHECK(qiskit_result_state(res, amps, 8) == 8);
+    norm = amps[0] * amps[0] + amps[1] * amps[1] + amps[14] * amps[14] +
+           amps[15] * amps[15];
+    CHECK(fabs(norm - 1.) < 1e-9);
+  }
+  CHECK(strstr(qiskit_result_json(res), "\"counts\"") != NULL);
+  qiskit_result_free(res);
+  qiskit_circuit_free(circ);
+}
+
+/* Checks that conditional operations are applied only if the clbits match */
+static void test_conditional(void) {
+  const uint64_t q0[] = {0}, q1[] = {1}, q2[] = {2};
+  const uint64_t c0[] = {0}, c1[] = {1}, c2[] = {2};
+  const qiskit_operation ops[] = {
+      {"x", q0, 1, NULL, 0, NULL, 0, 0, 0},
+      {"measure", q0, 1, c0, 1, NULL, 0, 0, 0},
+      {"x", q1, 1, NULL, 0, NULL, 0, 1, 1}, /* applied */
+      {"x", q2, 1, NULL, 0, NULL, 0, 1, 0}, /* not applied */
+      {"measure", q1, 1, c1, 1, NULL, 0, 0, 0},
+      {"measure", q2, 1, c2, 1, NULL, 0, 0, 0}};
+  qiskit_circuit *circ = qiskit_circuit_create(3, 3, ops, 6);
+  CHECK(circ != NULL);
+
+  qiskit_config config;
+  qiskit_config_init(&config);
+  config.shots = 10;
+  qiskit_result *res = qiskit_run(circ, &config);
+  CHECK(qiskit_result_success(res));
+  uint64_t outcome = 0, count = 0;
+  CHECK(qiskit_result_counts(res, &outcome, &count, 1) == 1);
+  CHECK(outcome == 3 && count == 10);
+  qiskit_result_free(res);
+  qiskit_circuit_free(circ);
+}
+
+/* Checks that failures are reported */
+static void test_errors(void) {
+  const uint64_t q0[] = {0}, q1[] = {1};
+  const qiskit_operation bad_gate[] = {{"foo", q0, 1, NULL, 0, NULL, 0, 0, 0}};
+  const qiskit_operation bad_qubit[] = {{"x", q1, 1, NULL, 0, NULL, 0, 0, 0}};
+  qiskit_config config;
+  qiskit_config_init(&config);
+
+  qiskit_circuit *circ = qiskit_circuit_create(1, 0, bad_gate, 1);
+  CHECK(circ != NULL);
+  qiskit_result *res = qiskit_run(circ, &config);
+  CHECK(res != NULL && !qiskit_result_success(res));
+  CHECK(strstr(qiskit_last_error(), "invalid operation") != NULL);
+  CHECK(strstr(qiskit_result_json(res), "\"success\":false") != NULL);
+  CHECK(qiskit_result_num_outcomes(res) == 0);
+  qiskit_result_free(res);
+  qiskit_circuit_free(circ);
+
+  circ = qiskit_circuit_create(1, 0, bad_qubit, 1);
+  res = qiskit_run(circ, &config);
+  CHECK(!qiskit_result_success(res));
+  CHECK(strstr(qiskit_result_status(res), "out of range") != NULL);
+  qiskit_result_free(res);
+  qiskit_circuit_free(circ);
+
+  config.options = "not json";
+  circ = qiskit_circuit_create(1, 0, NULL, 0);
+  res = qiskit_run(circ, &config);
+  CHECK(!qiskit_result_success(res));
+  qiskit_result_free(res);
+  qiskit_circuit_free(circ);
+
+  CHECK(qiskit_run(NULL, &config) == NULL);
+}
+
+int main(void) {
+  CHECK(qiskit_api_version() == QISKIT_SIMULATOR_API_VERSION);
+  test_ghz("qubit");
+  test_ghz("ideal");
+  test_ghz("clifford");
+  test_conditional();
+  test_errors();
+  if (failures == 0)
+    printf("capi_test: OK\n");
+  return failures != 0;
+}
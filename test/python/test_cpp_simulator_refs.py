@@ -0,0 +1,214 @@
+# -*- coding: utf-8 -*-
+# pylint: disable=invalid-name,missing-docstring
+
+# Copyright 2017 IBM RESEARCH. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# =============================================================================
+
+import json
+import mmap
+import numbers
+import os
+import socket
+import struct
+import subprocess
+import tempfile
+import time
+import unittest
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+import qiskit
+from .common import QiskitTestCase
+
+CPP_TEST_PATH = os.path.join(qiskit.__path__[0], '../src/cpp-simulator/test')
+SIMULATOR_PATH = os.path.join(qiskit.__path__[0], '../out/qiskit_simulator')
+
+# Output values that depend on the machine running the simulator
+IGNORED_KEYS = ['time_taken', 'backend', 'threads_shot']
+
+
+def _load_array(val, cwd):
+    """Load an array written to a .npy file or shared memory segment."""
+    if 'file' in val:
+        arr = np.load(os.path.join(cwd, val['file']))
+    else:
+        path = os.path.join('/dev/shm', val['shm'].lstrip('/'))
+        with open(path, 'r+b') as file:
+            buf = mmap.mmap(file.fileno(), 0)
+        os.unlink(path)
+        arr = np.ndarray(val['shape'], dtype=val['dtype'], buffer=buf).copy()
+    if np.iscomplexobj(arr):
+        arr = np.stack([arr.real, arr.imag], axis=-1)
+    return arr.tolist()
+
+
+def _normalize(obj, cwd):
+    """Drop machine dependent values and replace binary array references
+    by the arrays in the JSON format of the simulator."""
+    if isinstance(obj, dict):
+        if 'dtype' in obj and ('file' in obj or 'shm' in obj):
+            return _load_array(obj, cwd)
+        return {key: _normalize(val, cwd) for key, val in obj.items()
+                if key not in IGNORED_KEYS}
+    if isinstance(obj, list):
+        return [_normalize(val, cwd) for val in obj]
+    return obj
+
+
+def _call_server(path, text):
+    """Send a request to a simulator server and return its response."""
+    data = text.encode()
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(path)
+        sock.sendall(struct.pack('<Q', len(data)) + data)
+        with sock.makefile('rb') as file:
+            size = struct.unpack('<Q', file.read(8))[0]
+            return file.read(size).decode()
+
+
+def _parse(text, cwd):
+    """Parse simulator output, which is a list of lines if it is streamed."""
+    try:
+        return _normalize(json.loads(text), cwd)
+    except ValueError:
+        return [_normalize(json.loads(line), cwd)
+                for line in text.splitlines() if line.strip()]
+
+
+@unittest.skipIf(not os.path.exists(SIMULATOR_PATH),
+                 'C++ simulator executable not built')
+class TestCppSimulatorRefs(QiskitTestCase):
+    """
+    Compare the output of the C++ simulator for each qobj in
+    src/cpp-simulator/test/inputs with its reference in test/refs.
+
+    Floats are compared to 1e-9, and arrays written to .npy files or shared
+    memory are compared by value. Qobjs are run in a temporary directory,
+    which holds any files they write.
+    """
+
+    def assertOutputEqual(self, out, ref, path='output'):
+        if isinstance(ref, dict):
+            self.assertIsInstance(out, dict, path)
+            self.assertEqual(sorted(out), sorted(ref), path)
+            for key in ref:
+                self.assertOutputEqual(out[key], ref[key], path + '.' + key)
+        elif isinstance(ref, list):
+            self.assertIsInstance(out, list, path)
+            self.assertEqual(len(out), len(ref), path)
+            for j, (oval, rval) in enumerate(zip(out, ref)):
+                self.assertOutputEqual(oval, rval, '%s[%d]' % (path, j))
+        elif isinstance(ref, numbers.Real) and not isinstance(ref, bool):
+            self.assertAlmostEqual(out, ref, places=9, msg=path)
+        else:
+            self.assertEqual(out, ref, path)
+
+    def input_names(self):
+        names = sorted(os.path.splitext(file)[0] for file in
+                       os.listdir(os.path.join(CPP_TEST_PATH, 'inputs')))
+        self.assertTrue(names)
+        return names
+
+    def load_ref(self, name):
+        with open(os.path.join(CPP_TEST_PATH, 'refs', name + '.ref')) as file:
+            return _parse(file.read(), None)
+
+    def run_input(self, name):
+        """Run a test input and return its parsed output."""
+        qobj = os.path.abspath(os.path.join(CPP_TEST_PATH, 'inputs',
+                                            name + '.json'))
+        with tempfile.TemporaryDirectory() as cwd:
+            proc = subprocess.run([os.path.abspath(SIMULATOR_PATH), qobj],
+                                  cwd=cwd, stdout=subprocess.PIPE,
+                                  stderr=subprocess.PIPE, check=False)
+            return _parse(proc.stdout.decode(), cwd)
+
+    def test_refs(self):
+        for name in self.input_names():
+            with self.subTest(input=name):
+                self.assertOutputEqual(self.run_input(name),
+                                       self.load_ref(name))
+
+    def test_truncated_input(self):
+        """Qobjs that end early fail with a parse error."""
+        texts = ['{"id": "t", "config": {"shots": 1}',
+                 '{"id": "t", "config": {"shots": 1}, "circuits": [',
+                 '{"id": "t", "config": {"shots": 1}, "circuits": []',
+                 '{"id": "t", "config": {"shots": 1}, "circuits": [], "x": 1']
+        for text in texts:
+            with self.subTest(text=text), \
+                    tempfile.TemporaryDirectory() as cwd:
+                proc = subprocess.run([os.path.abspath(SIMULATOR_PATH), '-'],
+                                      input=text.encode(), cwd=cwd,
+                                      stdout=subprocess.PIPE,
+                                      stderr=subprocess.PIPE, check=False)
+                out = _parse(proc.stdout.decode(), cwd)
+                self.assertFalse(out['success'])
+                self.assertIn('parse error - unexpected end of input',
+                              out['status'])
+                self.assertEqual(out.get('result', []), [])
+
+    def test_refs_server(self):
+        """Run the test inputs concurrently on a simulator server."""
+        names = self.input_names()
+        with tempfile.TemporaryDirectory() as cwd:
+            path = os.path.join(cwd, 'simulator.sock')
+            server = subprocess.Popen(
+                [os.path.abspath(SIMULATOR_PATH), '--server', path],
+                cwd=cwd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+            try:
+                for _ in range(100):
+                    if os.path.exists(path):
+                        break
+                    time.sleep(0.1)
+                texts = []
+                for name in names:
+                    with open(os.path.join(CPP_TEST_PATH, 'inputs',
+                                           name + '.json')) as file:
+                        texts.append(file.read())
+                with ThreadPoolExecutor(max_workers=4) as pool:
+                    outputs = dict(zip(names, pool.map(
+                        lambda text: _call_server(path, text), texts)))
+                for name in names:
+                    with self.subTest(input=name):
+                        self.assertOutputEqual(_parse(outputs[name], cwd),
+                                               self.load_ref(name))
+                self.assertIn('success',
+                              json.loads(_call_server(path, 'not json')))
+                # An oversized request is rejected without stopping the
+                # server, which answers the requests that follow
+                with socket.socket(socket.AF_UNIX,
+                                   socket.SOCK_STREAM) as sock:
+                    sock.connect(path)
+                    sock.sendall(struct.pack('<Q', 1 << 62))
+                    with sock.makefile('rb') as file:
+                        size = struct.unpack('<Q', file.read(8))[0]
+                        reply = json.loads(file.read(size).decode())
+                        self.assertFalse(reply['success'])
+                        self.assertEqual(file.read(), b'')
+                self.assertIsNone(server.poll())
+                self.assertOutputEqual(
+                    _parse(_call_server(path, texts[0]), cwd),
+                    self.load_ref(names[0]))
+            finally:
+                _call_server(path, json.dumps({'command': 'shutdown'}))
+                server.wait(timeout=60)
+            self.assertFalse(os.path.exists(path))
+
+
+if __name__ == '__main__':
+    unittest.main()
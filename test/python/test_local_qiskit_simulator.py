@@ -17,12 +17,22 @@
 
 # =============================================================================
 
+import copy
+import json
 import os
+import socket
+import struct
+import subprocess
+import tempfile
+import time
 import unittest
 
+import numpy as np
+
 import qiskit
 import qiskit.backends._qiskit_cpp_simulator as qiskitsimulator
 from qiskit import ClassicalRegister
+from qiskit import QISKitError
 from qiskit import QuantumCircuit
 from qiskit import QuantumJob
 from qiskit import QuantumRegister
@@ -100,6 +110,112 @@ class TestLocalQiskitSimulator(QiskitTestCase):
         self.assertEqual(set(result.get_counts('test_circuit2').keys()),
                          set(expected2.keys()))
 
+    def test_run_qobj_parse_error(self):
+        """Circuits before a circuit that cannot be parsed are still run."""
+        try:
+            simulator = qiskitsimulator.QISKitCppSimulator()
+        except FileNotFoundError as fnferr:
+            raise unittest.SkipTest(
+                'cannot find {} in path'.format(fnferr))
+        qobj = copy.deepcopy(self.qobj)
+        invalid = copy.deepcopy(qobj['circuits'][0])
+        invalid['name'] = 'invalid_circuit'
+        invalid['compiled_circuit']['operations'].append(
+            {'name': 'not_a_gate', 'qubits': [0]})
+        qobj['circuits'].insert(1, invalid)
+        result = simulator.run(QuantumJob(qobj,
+                                          backend='local_qiskit_simulator',
+                                          preformatted=True))
+
+        self.assertTrue(result.get_status().startswith('ERROR'))
+        self.assertIn('not_a_gate', result.get_status())
+        self.assertEqual(len(result), 3)
+        self.assertEqual(result.get_circuit_status(0), 'DONE')
+        self.assertEqual(sum(result.get_counts('test_circuit1').values()), 100)
+        for j in [1, 2]:
+            self.assertEqual(result.get_circuit_status(j), result.get_status())
+        self.assertRaises(QISKitError, result.get_counts, 'invalid_circuit')
+        self.assertRaises(QISKitError, result.get_counts, 'test_circuit2')
+
+    def test_run_binary_qobj(self):
+        """A binary qobj gives the same results as the JSON qobj."""
+        try:
+            simulator = qiskitsimulator.QISKitCppSimulator()
+        except FileNotFoundError as fnferr:
+            raise unittest.SkipTest(
+                'cannot find {} in path'.format(fnferr))
+        # Measuring qubit 0 of the initial state selects whether the
+        # conditional x is applied to qubit 1
+        qobj = {'id': 'test_binary_qobj',
+                'config': {'shots': 20, 'seed': self.seed,
+                           'max_threads_shot': 1,
+                           'initial_state': np.array([0.6, 0, 0, 0.8j]),
+                           'data': ['counts', 'quantumstates']},
+                'circuits': [{
+                    'name': 'conditional',
+                    'compiled_circuit': {
+                        'header': {'number_of_qubits': 2,
+                                   'number_of_clbits': 2,
+                                   'qubit_labels': [['q', 0], ['q', 1]],
+                                   'clbit_labels': [['c', 2]]},
+                        'operations': [
+                            {'name': 'measure', 'qubits': [0],
+                             'clbits': [0]},
+                            {'name': 'x', 'qubits': [1],
+                             'conditional': {'type': 'equals', 'mask': '0x1',
+                                             'val': '0x0'}},
+                            {'name': 'measure', 'qubits': [1],
+                             'clbits': [1]}]}}]}
+        results = []
+        for binary in [False, True]:
+            job_qobj = copy.deepcopy(qobj)
+            job_qobj['config']['binary_qobj'] = binary
+            results.append(simulator.run(QuantumJob(
+                job_qobj, backend='local_qiskit_simulator',
+                preformatted=True)))
+
+        json_result, binary_result = results
+        self.assertEqual(binary_result.get_status(), 'COMPLETED')
+        self.assertEqual(set(json_result.get_counts('conditional')),
+                         {'10', '11'})
+        self.assertEqual(binary_result.get_counts('conditional'),
+                         json_result.get_counts('conditional'))
+        self.assertTrue(np.array_equal(
+            binary_result.get_data('conditional')['quantum_states'],
+            json_result.get_data('conditional')['quantum_states']))
+
+    def test_run_qobj_server(self):
+        try:
+            simulator = qiskitsimulator.QISKitCppSimulator()
+        except FileNotFoundError as fnferr:
+            raise unittest.SkipTest(
+                'cannot find {} in path'.format(fnferr))
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, 'simulator.sock')
+            server = subprocess.Popen(
+                [simulator._configuration['exe'], '--server', path])
+            try:
+                for _ in range(100):
+                    if os.path.exists(path):
+                        break
+                    time.sleep(0.1)
+                server_simulator = qiskitsimulator.QISKitCppSimulator(
+                    {'name': 'local_qiskit_simulator', 'server': path})
+                result = server_simulator.run(self.q_job)
+            finally:
+                request = json.dumps({'command': 'shutdown'}).encode()
+                with socket.socket(socket.AF_UNIX,
+                                   socket.SOCK_STREAM) as sock:
+                    sock.connect(path)
+                    sock.sendall(struct.pack('<Q', len(request)) + request)
+                    sock.recv(8)
+                server.wait(timeout=60)
+
+        self.assertEqual(result.get_status(), 'COMPLETED')
+        self.assertEqual(set(result.get_counts('test_circuit2').keys()),
+                         set(simulator.run(self.q_job).get_counts(
+                             'test_circuit2').keys()))
+
 
 if __name__ == '__main__':
     unittest.main(verbosity=2)